@@ -0,0 +1,77 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include "treadmill/AliasTable.h"
+
+#include <cmath>
+#include <limits>
+
+#include <glog/logging.h>
+
+namespace facebook {
+namespace windtunnel {
+namespace treadmill {
+
+namespace {
+
+uint64_t toThreshold(double probability) {
+  // 2^64 doesn't fit; the last value is as good as certain.
+  if (probability >= 1) {
+    return std::numeric_limits<uint64_t>::max();
+  }
+  return uint64_t(std::ldexp(probability, 64));
+}
+
+} // namespace
+
+AliasTable::AliasTable(const std::vector<double>& weights)
+    : threshold_(weights.size()), alias_(weights.size()) {
+  CHECK(!weights.empty());
+  CHECK_LE(weights.size(), std::numeric_limits<uint32_t>::max());
+  double total = 0;
+  for (auto weight : weights) {
+    CHECK_GE(weight, 0);
+    total += weight;
+  }
+  CHECK_GT(total, 0);
+
+  // Scale so that the average column holds probability 1, then fill every
+  // small column up with the excess of a large one.
+  size_t n = weights.size();
+  std::vector<double> scaled(n);
+  std::vector<uint32_t> small, large;
+  for (size_t i = 0; i < n; ++i) {
+    scaled[i] = weights[i] * n / total;
+    (scaled[i] < 1 ? small : large).push_back(i);
+  }
+  while (!small.empty() && !large.empty()) {
+    auto s = small.back();
+    small.pop_back();
+    auto l = large.back();
+    threshold_[s] = toThreshold(scaled[s]);
+    alias_[s] = l;
+    scaled[l] -= 1 - scaled[s];
+    if (scaled[l] < 1) {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+  // Whatever is left is 1 up to rounding.
+  for (auto columns : {&small, &large}) {
+    for (auto i : *columns) {
+      threshold_[i] = toThreshold(1);
+      alias_[i] = i;
+    }
+  }
+}
+
+} // namespace treadmill
+} // namespace windtunnel
+} // namespace facebook
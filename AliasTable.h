@@ -0,0 +1,52 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace facebook {
+namespace windtunnel {
+namespace treadmill {
+
+/**
+ * Draws an index in [0, n) with probability proportional to its weight in
+ * O(1), using Vose's alias method.
+ *
+ * A draw takes a single 64-bit random number: the high half of r * n picks a
+ * column, and the low half, uniform given the column, decides between the
+ * column and its alias.
+ */
+class AliasTable {
+ public:
+  explicit AliasTable(const std::vector<double>& weights);
+
+  template <class Engine>
+  size_t operator()(Engine& engine) const {
+    auto product = (unsigned __int128)engine() * threshold_.size();
+    auto column = size_t(product >> 64);
+    return uint64_t(product) < threshold_[column] ? column : alias_[column];
+  }
+
+  size_t size() const {
+    return threshold_.size();
+  }
+
+ private:
+  // Probability of keeping the column, scaled to 2^64
+  std::vector<uint64_t> threshold_;
+  std::vector<uint32_t> alias_;
+};
+
+} // namespace treadmill
+} // namespace windtunnel
+} // namespace facebook
@@ -0,0 +1,93 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#pragma once
+
+#include <mutex>
+#include <vector>
+
+#include <folly/dynamic.h>
+#include <folly/futures/Future.h>
+
+#include "treadmill/Histogram.h"
+
+namespace facebook {
+namespace windtunnel {
+namespace treadmill {
+
+/**
+ * Decides when latency quantiles are known precisely enough to stop a run.
+ *
+ * Consecutive intervals are merged into batches of at least batch_ms, and
+ * every batch contributes one estimate of each quantile. Treating the batch
+ * estimates as independent (the method of batch means), the confidence
+ * interval of a quantile is mean +/- t * s / sqrt(batches). The run has
+ * converged once, for every quantile, the full width of that interval
+ * relative to the mean is below the target.
+ */
+class ConvergenceMonitor {
+ public:
+  struct Options {
+    // Quantiles in [0, 1]
+    std::vector<double> quantiles;
+    double target_relative_width;
+    double confidence;
+    int64_t batch_ms;
+    // Batches required before convergence is considered
+    int min_batches;
+    // Leading batches ignored as warm-up
+    int skip_batches;
+    int significant_bits;
+  };
+
+  explicit ConvergenceMonitor(Options options);
+
+  /**
+   * Feed the latency histogram of one interval. Called by the interval
+   * reporter thread.
+   */
+  void addInterval(const Histogram& latency, double interval_s);
+
+  // Fulfilled once every quantile has converged.
+  folly::SemiFuture<folly::Unit> getConvergedFuture();
+
+  // The precision achieved so far, for the results.
+  folly::dynamic toDynamic() const;
+
+  void print() const;
+
+ private:
+  struct Estimate {
+    double mean;
+    double low;
+    double high;
+    double relative_width;
+  };
+
+  // One Estimate per quantile; requires mutex_.
+  std::vector<Estimate> estimate() const;
+  bool converged(const std::vector<Estimate>& estimates) const;
+
+  const Options options_;
+  const size_t min_batch_samples_;
+
+  mutable std::mutex mutex_;
+  Histogram batch_;
+  double batch_s_{0};
+  int skipped_batches_{0};
+  // batch_quantiles_[q][batch]
+  std::vector<std::vector<double>> batch_quantiles_;
+  bool converged_{false};
+  folly::Promise<folly::Unit> converged_promise_;
+};
+
+} // namespace treadmill
+} // namespace windtunnel
+} // namespace facebook
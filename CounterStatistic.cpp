@@ -17,21 +17,86 @@
 
 #include <glog/logging.h>
 
+DEFINE_int32(
+    counter_max_subkeys,
+    1024,
+    "Maximum number of distinct subkeys per counter. Further subkeys are "
+    "counted together under __overflow__.");
+
 namespace facebook {
 namespace windtunnel {
 namespace treadmill {
 
+namespace {
+
+void constructSubkeyCount(void* raw) {
+  new (raw) folly::MutableAtom<int64_t>(0);
+}
+
+} // namespace
+
+CounterStatistic::CounterStatistic(
+    const std::string& /* name */,
+    size_t max_subkeys)
+    : max_subkeys_(max_subkeys), subkey_count_(max_subkeys + 1) {}
+
+int64_t CounterStatistic::getCount() const {
+  int64_t count = 0;
+  for (const auto& shard : shards_) {
+    count += shard.count.load(std::memory_order_relaxed);
+  }
+  return count;
+}
+
+int64_t CounterStatistic::getCount(const std::string& subkey) const {
+  auto it = subkey_count_.find(subkey);
+  return it == subkey_count_.cend() ? 0 : it->second.data.load();
+}
+
+std::atomic<int64_t>& CounterStatistic::findOrInsertSubkey(
+    const std::string& subkey) {
+  auto it = subkey_count_.find(subkey);
+  if (it != subkey_count_.cend()) {
+    return it->second.data;
+  }
+
+  // Reserve room for a new subkey before inserting it, so that racing
+  // inserters can't push the map past max_subkeys_.
+  if (number_of_subkeys_.fetch_add(1, std::memory_order_relaxed) >=
+      max_subkeys_) {
+    number_of_subkeys_.fetch_sub(1, std::memory_order_relaxed);
+    return subkey_count_.findOrConstruct(kOverflowSubkey, constructSubkeyCount)
+        .first->second.data;
+  }
+  auto result = subkey_count_.findOrConstruct(subkey, constructSubkeyCount);
+  if (!result.second) {
+    // Somebody else inserted the same subkey first.
+    number_of_subkeys_.fetch_sub(1, std::memory_order_relaxed);
+  }
+  return result.first->second.data;
+}
+
 /**
  * Print out all the statistic
  */
 void CounterStatistic::printStatistic() const {
-  LOG(INFO) << "Count: " << count_;
+  LOG(INFO) << "Count: " << getCount();
   std::for_each(
       subkey_count_.cbegin(), subkey_count_.cend(), [](const auto& p) {
         LOG(INFO) << "Count[" << p.first << "]: " << p.second.data;
       });
 }
 
+folly::dynamic CounterStatistic::toDynamic() const {
+  folly::dynamic subkeys = folly::dynamic::object;
+  std::for_each(
+      subkey_count_.cbegin(), subkey_count_.cend(), [&](const auto& p) {
+        subkeys[p.first] = p.second.data.load();
+      });
+  return folly::dynamic::object("count", getCount())(
+      "subkeys", std::move(subkeys));
+}
+
 } // namespace treadmill
 } // namespace windtunnel
 } // namespace facebook
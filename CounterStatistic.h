@@ -10,52 +10,82 @@
 
 #pragma once
 
+#include <array>
 #include <atomic>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 #include <folly/AtomicUnorderedMap.h>
+#include <folly/dynamic.h>
+#include <gflags/gflags.h>
+
+DECLARE_int32(counter_max_subkeys);
 
 namespace facebook {
 namespace windtunnel {
 namespace treadmill {
 
+/**
+ * A counter that can be increased concurrently from many threads, with
+ * optional per-subkey counts.
+ *
+ * The total is split over cache-line sized shards. Each thread is assigned a
+ * shard the first time it touches any counter, so with up to kNumberOfShards
+ * threads no two threads ever write the same cache line; past that threads
+ * share shards, which is still exact, just contended. Reads add up all shards.
+ *
+ * At most max_subkeys distinct subkeys are tracked. Increments for any further
+ * subkey go to the kOverflowSubkey bucket, so a high-cardinality subkey (an
+ * exception message, say) can't exhaust memory.
+ */
 class CounterStatistic {
  public:
-  explicit CounterStatistic(const std::string& /* name */) {}
+  static constexpr size_t kNumberOfShards = 64;
+  static constexpr const char* kOverflowSubkey = "__overflow__";
 
-  void increase(int64_t n, const std::string& subkey) {
-    count_ += n;
+  explicit CounterStatistic(
+      const std::string& /* name */,
+      size_t max_subkeys = FLAGS_counter_max_subkeys);
+
+  void increase(int64_t n, const std::string& subkey = "") {
+    shards_[shardIndex()].count.fetch_add(n, std::memory_order_relaxed);
     if (!subkey.empty()) {
-      subkey_count_
-          .findOrConstruct(
-              subkey,
-              [](void* raw) { return new (raw) std::atomic<int64_t>{0}; })
-          .first->second.data += n;
+      findOrInsertSubkey(subkey).fetch_add(n, std::memory_order_relaxed);
     }
   }
 
-  int64_t getCount() const {
-    return count_;
-  }
+  int64_t getCount() const;
 
-  int64_t getCount(const std::string& subkey) {
-    return subkey_count_
-        .findOrConstruct(
-            subkey,
-            [=](void* raw) { return new (raw) std::atomic<int64_t>{0}; })
-        .first->second.data;
-  }
+  // Count of a subkey; 0 if the subkey was never increased.
+  int64_t getCount(const std::string& subkey) const;
 
   void printStatistic() const;
 
+  folly::dynamic toDynamic() const;
+
  private:
-  int64_t count_ = 0;
-  folly::AtomicUnorderedInsertMap<std::string, folly::MutableAtom<int64_t>>
-      subkey_count_ = folly::
-          AtomicUnorderedInsertMap<std::string, folly::MutableAtom<int64_t>>{
-              10 * 1024};
+  struct alignas(64) Shard {
+    std::atomic<int64_t> count{0};
+  };
+
+  using SubkeyMap =
+      folly::AtomicUnorderedInsertMap<std::string, folly::MutableAtom<int64_t>>;
+
+  static size_t shardIndex() {
+    static std::atomic<size_t> next_shard{0};
+    static thread_local size_t shard =
+        next_shard.fetch_add(1, std::memory_order_relaxed) % kNumberOfShards;
+    return shard;
+  }
+
+  std::atomic<int64_t>& findOrInsertSubkey(const std::string& subkey);
+
+  std::array<Shard, kNumberOfShards> shards_;
+  const size_t max_subkeys_;
+  std::atomic<size_t> number_of_subkeys_{0};
+  // One extra slot for the overflow bucket.
+  SubkeyMap subkey_count_;
 };
 
 } // namespace treadmill
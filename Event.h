@@ -10,6 +10,8 @@
 
 #pragma once
 
+#include <cstdint>
+
 #include <folly/dynamic.h>
 
 namespace facebook {
@@ -37,9 +39,21 @@ class Event {
     return extraData_;
   }
 
+  /**
+   * For SEND_REQUEST, when the scheduler wanted the request to be sent, in
+   * nowNs() nanoseconds; 0 if unknown.
+   */
+  int64_t getTimestampNs() const {
+    return timestampNs_;
+  }
+  void setTimestampNs(int64_t timestamp_ns) {
+    timestampNs_ = timestamp_ns;
+  }
+
  private:
   EventType eventType_;
   folly::dynamic extraData_;
+  int64_t timestampNs_{0};
 };
 
 } // namespace treadmill
@@ -0,0 +1,222 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include "treadmill/Histogram.h"
+
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+#include <folly/Format.h>
+#include <glog/logging.h>
+
+namespace facebook {
+namespace windtunnel {
+namespace treadmill {
+
+namespace {
+
+constexpr uint64_t kEmptyMin = std::numeric_limits<uint64_t>::max();
+
+size_t numberOfBuckets(int significant_bits) {
+  // 2^S linear buckets, then 2^(S-1) buckets for each of the remaining
+  // 64 - S powers of two.
+  return static_cast<size_t>(66 - significant_bits)
+      << (significant_bits - 1);
+}
+
+} // namespace
+
+Histogram::Histogram(int significant_bits)
+    : significant_bits_(significant_bits),
+      number_of_buckets_(numberOfBuckets(significant_bits)),
+      counts_(new std::atomic<uint64_t>[number_of_buckets_]),
+      min_(kEmptyMin) {
+  CHECK_GE(significant_bits, kMinSignificantBits);
+  CHECK_LE(significant_bits, kMaxSignificantBits);
+  for (size_t i = 0; i < number_of_buckets_; ++i) {
+    counts_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+Histogram::Histogram(const Histogram& other)
+    : Histogram(other.significant_bits_) {
+  merge(other);
+}
+
+void Histogram::merge(const Histogram& other) {
+  CHECK_EQ(significant_bits_, other.significant_bits_);
+  for (size_t i = 0; i < number_of_buckets_; ++i) {
+    auto count = other.counts_[i].load(std::memory_order_relaxed);
+    if (count != 0) {
+      counts_[i].fetch_add(count, std::memory_order_relaxed);
+    }
+  }
+  sum_.fetch_add(
+      other.sum_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  updateMin(other.min_.load(std::memory_order_relaxed));
+  updateMax(other.max_.load(std::memory_order_relaxed));
+}
+
+void Histogram::drainInto(Histogram& target) {
+  CHECK_EQ(significant_bits_, target.significant_bits_);
+  for (size_t i = 0; i < number_of_buckets_; ++i) {
+    if (counts_[i].load(std::memory_order_relaxed) != 0) {
+      auto count = counts_[i].exchange(0, std::memory_order_relaxed);
+      target.counts_[i].fetch_add(count, std::memory_order_relaxed);
+    }
+  }
+  target.sum_.fetch_add(
+      sum_.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+  target.updateMin(min_.exchange(kEmptyMin, std::memory_order_relaxed));
+  target.updateMax(max_.exchange(0, std::memory_order_relaxed));
+}
+
+void Histogram::clear() {
+  for (size_t i = 0; i < number_of_buckets_; ++i) {
+    counts_[i].store(0, std::memory_order_relaxed);
+  }
+  sum_.store(0, std::memory_order_relaxed);
+  min_.store(kEmptyMin, std::memory_order_relaxed);
+  max_.store(0, std::memory_order_relaxed);
+}
+
+double Histogram::getQuantile(double quantile) const {
+  return getQuantiles({quantile})[0];
+}
+
+std::vector<double> Histogram::getQuantiles(
+    const std::vector<double>& quantiles) const {
+  std::vector<double> result(quantiles.size(), 0.0);
+  auto count = getCount();
+  if (count == 0) {
+    return result;
+  }
+
+  // Visit the quantiles in increasing order so one pass over the buckets
+  // answers all of them.
+  std::vector<size_t> order(quantiles.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return quantiles[a] < quantiles[b];
+  });
+
+  uint64_t seen = 0;
+  size_t bucket = 0;
+  for (auto i : order) {
+    double q = std::min(std::max(quantiles[i], 0.0), 1.0);
+    uint64_t rank = std::max<uint64_t>(1, std::ceil(q * count));
+    while (bucket < number_of_buckets_) {
+      auto c = counts_[bucket].load(std::memory_order_relaxed);
+      if (seen + c >= rank) {
+        break;
+      }
+      seen += c;
+      ++bucket;
+    }
+    // Concurrent writers can make the total larger than what we walk over.
+    result[i] = bucketValue(std::min(bucket, number_of_buckets_ - 1));
+  }
+  return result;
+}
+
+uint64_t Histogram::getCount() const {
+  uint64_t count = 0;
+  for (size_t i = 0; i < number_of_buckets_; ++i) {
+    count += counts_[i].load(std::memory_order_relaxed);
+  }
+  return count;
+}
+
+double Histogram::getMean() const {
+  auto count = getCount();
+  return count == 0 ? 0.0 : getSum() / count;
+}
+
+uint64_t Histogram::getMin() const {
+  auto min = min_.load(std::memory_order_relaxed);
+  return min == kEmptyMin ? 0 : min;
+}
+
+folly::dynamic Histogram::toDynamic(
+    const std::vector<double>& quantiles) const {
+  folly::dynamic lower_bounds = folly::dynamic::array;
+  folly::dynamic counts = folly::dynamic::array;
+  uint64_t total = 0;
+  forEachBucket([&](uint64_t lower, uint64_t /* upper */, uint64_t count) {
+    lower_bounds.push_back(static_cast<int64_t>(lower));
+    counts.push_back(static_cast<int64_t>(count));
+    total += count;
+  });
+
+  folly::dynamic quantile_values = folly::dynamic::object;
+  auto values = getQuantiles(quantiles);
+  for (size_t i = 0; i < quantiles.size(); ++i) {
+    quantile_values[folly::sformat("p{:g}", quantiles[i] * 100)] = values[i];
+  }
+
+  return folly::dynamic::object("significant_bits", significant_bits_)(
+      "count", static_cast<int64_t>(total))("sum", getSum())(
+      "min", static_cast<int64_t>(getMin()))(
+      "max", static_cast<int64_t>(getMax()))(
+      "avg", total == 0 ? 0.0 : getSum() / total)(
+      "quantiles", std::move(quantile_values))(
+      "bucket_lower_bounds", std::move(lower_bounds))(
+      "bucket_counts", std::move(counts));
+}
+
+Histogram Histogram::fromDynamic(const folly::dynamic& histogram) {
+  Histogram result(histogram["significant_bits"].asInt());
+  const auto& lower_bounds = histogram["bucket_lower_bounds"];
+  const auto& counts = histogram["bucket_counts"];
+  CHECK_EQ(lower_bounds.size(), counts.size())
+      << "Histogram has mismatched bucket arrays";
+  for (size_t i = 0; i < lower_bounds.size(); ++i) {
+    auto index = result.bucketIndex(lower_bounds[i].asInt());
+    result.counts_[index].fetch_add(
+        counts[i].asInt(), std::memory_order_relaxed);
+  }
+  if (result.getCount() != 0) {
+    result.sum_.store(
+        static_cast<uint64_t>(histogram["sum"].asDouble()),
+        std::memory_order_relaxed);
+    result.min_.store(histogram["min"].asInt(), std::memory_order_relaxed);
+    result.max_.store(histogram["max"].asInt(), std::memory_order_relaxed);
+  }
+  return result;
+}
+
+double Histogram::bucketValue(size_t index) const {
+  auto lower = bucketLowerBound(index);
+  double mid = lower + (bucketWidth(index) - 1) / 2.0;
+  auto min = static_cast<double>(getMin());
+  auto max = static_cast<double>(getMax());
+  return std::min(std::max(mid, min), max);
+}
+
+void Histogram::updateMin(uint64_t value) {
+  auto current = min_.load(std::memory_order_relaxed);
+  while (value < current &&
+         !min_.compare_exchange_weak(
+             current, value, std::memory_order_relaxed)) {
+  }
+}
+
+void Histogram::updateMax(uint64_t value) {
+  auto current = max_.load(std::memory_order_relaxed);
+  while (value > current &&
+         !max_.compare_exchange_weak(
+             current, value, std::memory_order_relaxed)) {
+  }
+}
+
+} // namespace treadmill
+} // namespace windtunnel
+} // namespace facebook
@@ -0,0 +1,203 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <folly/dynamic.h>
+
+namespace facebook {
+namespace windtunnel {
+namespace treadmill {
+
+/**
+ * Fixed-memory log-linear histogram in the spirit of HdrHistogram.
+ *
+ * Values are recorded as non-negative integers. With S significant bits, the
+ * values [0, 2^S) get one bucket each, and every higher power-of-two range
+ * [2^k, 2^(k+1)) is split into 2^(S-1) equally wide buckets. Any value read
+ * back from the histogram is therefore within a relative error of 2^-(S-1)
+ * of a recorded value, over the whole 64-bit range.
+ *
+ * Recording is a couple of bit operations and relaxed atomic adds, so one
+ * instance can be shared between worker threads. Histograms of the same
+ * precision merge exactly by summing bucket counts.
+ */
+class Histogram {
+ public:
+  static constexpr int kDefaultSignificantBits = 8;
+  static constexpr int kMinSignificantBits = 2;
+  static constexpr int kMaxSignificantBits = 14;
+
+  explicit Histogram(int significant_bits = kDefaultSignificantBits);
+
+  Histogram(const Histogram& other);
+  Histogram& operator=(const Histogram& other) = delete;
+
+  /**
+   * Record a value. Negative values are clamped to zero and fractional values
+   * are rounded to the nearest integer.
+   */
+  void addValue(double value) {
+    addInteger(toInteger(value), 1);
+  }
+
+  /**
+   * Record a value count times.
+   */
+  void addValue(double value, uint64_t count) {
+    addInteger(toInteger(value), count);
+  }
+
+  void addInteger(uint64_t value, uint64_t count = 1) {
+    counts_[bucketIndex(value)].fetch_add(count, std::memory_order_relaxed);
+    sum_.fetch_add(value * count, std::memory_order_relaxed);
+    if (value < min_.load(std::memory_order_relaxed)) {
+      updateMin(value);
+    }
+    if (value > max_.load(std::memory_order_relaxed)) {
+      updateMax(value);
+    }
+  }
+
+  /**
+   * Add all samples of other to this histogram. Both histograms must have the
+   * same number of significant bits.
+   */
+  void merge(const Histogram& other);
+
+  /**
+   * Move all samples of this histogram into target, leaving this histogram
+   * empty. Every bucket is emptied with an atomic exchange, so samples added
+   * concurrently are either moved or stay behind for the next drain; none are
+   * lost.
+   */
+  void drainInto(Histogram& target);
+
+  /**
+   * Reset the histogram to its empty state.
+   */
+  void clear();
+
+  /**
+   * Value at the given quantile in [0.0, 1.0], or 0 for an empty histogram.
+   * The result is the midpoint of the bucket holding the quantile, clamped to
+   * the recorded minimum and maximum.
+   */
+  double getQuantile(double quantile) const;
+
+  /**
+   * Same as getQuantile() for a list of quantiles, in a single pass over the
+   * buckets. The returned values are in the order of the input.
+   */
+  std::vector<double> getQuantiles(const std::vector<double>& quantiles) const;
+
+  uint64_t getCount() const;
+
+  double getSum() const {
+    return static_cast<double>(sum_.load(std::memory_order_relaxed));
+  }
+
+  double getMean() const;
+
+  uint64_t getMin() const;
+
+  uint64_t getMax() const {
+    return max_.load(std::memory_order_relaxed);
+  }
+
+  int getSignificantBits() const {
+    return significant_bits_;
+  }
+
+  size_t getNumberOfBuckets() const {
+    return number_of_buckets_;
+  }
+
+  /**
+   * Summary statistics and every non-empty bucket. Buckets are written as two
+   * parallel arrays of lower bounds and counts, which is enough to rebuild the
+   * histogram exactly.
+   */
+  folly::dynamic toDynamic(const std::vector<double>& quantiles) const;
+
+  /**
+   * Rebuild a histogram from the output of toDynamic(), e.g. one read back
+   * from a result file.
+   */
+  static Histogram fromDynamic(const folly::dynamic& histogram);
+
+  /**
+   * Call fn(lower_bound, upper_bound, count) for every non-empty bucket in
+   * increasing order of value. Both bounds are inclusive.
+   */
+  template <class Fn>
+  void forEachBucket(Fn&& fn) const {
+    for (size_t i = 0; i < number_of_buckets_; ++i) {
+      auto count = counts_[i].load(std::memory_order_relaxed);
+      if (count != 0) {
+        auto lower = bucketLowerBound(i);
+        fn(lower, lower + (bucketWidth(i) - 1), count);
+      }
+    }
+  }
+
+  size_t bucketIndex(uint64_t value) const {
+    // Position of the highest set bit; or-ing in 1 keeps clz defined for 0.
+    int msb = 63 - __builtin_clzll(value | 1);
+    int shift = std::max(msb - (significant_bits_ - 1), 0);
+    return (static_cast<size_t>(shift) << (significant_bits_ - 1)) +
+        (value >> shift);
+  }
+
+  uint64_t bucketLowerBound(size_t index) const {
+    int shift = bucketShift(index);
+    return (index - (static_cast<size_t>(shift) << (significant_bits_ - 1)))
+        << shift;
+  }
+
+  uint64_t bucketWidth(size_t index) const {
+    return uint64_t(1) << bucketShift(index);
+  }
+
+ private:
+  static uint64_t toInteger(double value) {
+    // 2^64 is not representable as uint64_t, so clamp just below it.
+    constexpr double kMaxValue = 18446744073709549568.0;
+    return value > 0 ? static_cast<uint64_t>(std::min(value + 0.5, kMaxValue))
+                     : 0;
+  }
+
+  int bucketShift(size_t index) const {
+    return std::max(static_cast<int>(index >> (significant_bits_ - 1)) - 1, 0);
+  }
+
+  double bucketValue(size_t index) const;
+
+  void updateMin(uint64_t value);
+  void updateMax(uint64_t value);
+
+  const int significant_bits_;
+  const size_t number_of_buckets_;
+  std::unique_ptr<std::atomic<uint64_t>[]> counts_;
+  std::atomic<uint64_t> sum_{0};
+  std::atomic<uint64_t> min_;
+  std::atomic<uint64_t> max_{0};
+};
+
+} // namespace treadmill
+} // namespace windtunnel
+} // namespace facebook
@@ -0,0 +1,262 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include "treadmill/IntervalStatistics.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include <folly/Format.h>
+#include <folly/dynamic.h>
+#include <folly/json.h>
+#include <folly/system/ThreadName.h>
+#include <glog/logging.h>
+
+#include "treadmill/Util.h"
+
+namespace facebook {
+namespace windtunnel {
+namespace treadmill {
+
+namespace {
+
+const std::vector<double> kIntervalQuantiles = {0.5, 0.9, 0.99, 0.999, 1.0};
+
+std::string quantileName(double quantile) {
+  return folly::sformat("p{:g}", quantile * 100);
+}
+
+} // namespace
+
+IntervalReporter::IntervalReporter(
+    std::vector<WorkerIntervalStatistics*> workers,
+    const std::string& filename,
+    Format format,
+    int64_t period_ms,
+    int significant_bits)
+    : workers_(std::move(workers)),
+      file_(filename.empty() ? nullptr : fopen(filename.c_str(), "a")),
+      format_(format),
+      period_ns_(period_ms * (k_ns_per_s / 1000)),
+      significant_bits_(significant_bits) {
+  PCHECK(filename.empty() || file_ != nullptr) << "Failed to open "
+                                               << filename;
+  CHECK_GT(period_ms, 0);
+  if (file_ && format_ == Format::CSV && ftell(file_) == 0) {
+    std::string header =
+        "time,elapsed_s,interval_s,sent,completed,dropped,errors,outstanding,"
+        "sent_rate,throughput,success_rate,error_rate,latency_count,"
+        "latency_avg";
+    for (auto q : kIntervalQuantiles) {
+      header += "," + quantileName(q);
+    }
+    fprintf(file_, "%s\n", header.c_str());
+  }
+}
+
+IntervalReporter::~IntervalReporter() {
+  stop();
+  if (file_) {
+    fclose(file_);
+  }
+}
+
+/* static */ IntervalReporter::Format IntervalReporter::parseFormat(
+    const std::string& format) {
+  if (format == "json") {
+    return Format::JSON;
+  } else if (format == "csv") {
+    return Format::CSV;
+  }
+  LOG(FATAL) << "Unknown interval statistics format: " << format;
+  return Format::JSON;
+}
+
+void IntervalReporter::addListener(Listener listener) {
+  CHECK(!thread_) << "Listeners must be added before start()";
+  listeners_.push_back(std::move(listener));
+}
+
+void IntervalReporter::start() {
+  start_time_ = last_time_ = nowNs();
+  thread_ = std::make_unique<std::thread>([this] { this->loop(); });
+}
+
+void IntervalReporter::stop() {
+  if (!thread_) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    stopping_ = true;
+  }
+  stop_cv_.notify_all();
+  thread_->join();
+  thread_.reset();
+  report(nowNs());
+}
+
+void IntervalReporter::loop() {
+  folly::setThreadName("treadmill-intvl");
+  auto deadline = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    // Sleep until an absolute deadline so the intervals don't drift by the
+    // time spent reporting.
+    deadline += std::chrono::nanoseconds(period_ns_);
+    if (stop_cv_.wait_until(lock, deadline, [this] { return stopping_; })) {
+      return;
+    }
+    report(nowNs());
+  }
+}
+
+void IntervalReporter::report(int64_t now) {
+  IntervalSnapshot snapshot;
+  auto latency = std::make_shared<Histogram>(significant_bits_);
+  int64_t sent = 0, completed = 0, dropped = 0, errors = 0;
+  for (auto worker : workers_) {
+    worker->rotateInto(*latency);
+    WorkerSnapshot worker_snapshot = {worker->getSent(),
+                                      worker->getCompleted(),
+                                      worker->getDropped(),
+                                      worker->getErrors(),
+                                      worker->getOutstanding()};
+    sent += worker_snapshot.sent;
+    completed += worker_snapshot.completed;
+    dropped += worker_snapshot.dropped;
+    errors += worker_snapshot.errors;
+    snapshot.outstanding += worker_snapshot.outstanding;
+    snapshot.workers.push_back(worker_snapshot);
+    mergeSlowRequests(
+        snapshot.slow_requests,
+        worker->drainSlowRequests(),
+        worker->getSlowRequestCapacity());
+  }
+
+  snapshot.sequence = sequence_++;
+  snapshot.phase = workers_.empty() ? 0 : workers_.front()->getPhase();
+  snapshot.time = time_s();
+  snapshot.elapsed_s = double(now - start_time_) / k_ns_per_s;
+  snapshot.interval_s = double(now - last_time_) / k_ns_per_s;
+  snapshot.sent = sent - last_sent_;
+  snapshot.completed = completed - last_completed_;
+  snapshot.dropped = dropped - last_dropped_;
+  snapshot.errors = errors - last_errors_;
+  if (snapshot.interval_s > 0) {
+    snapshot.sent_rate = snapshot.sent / snapshot.interval_s;
+    snapshot.throughput = snapshot.completed / snapshot.interval_s;
+    snapshot.success_rate =
+        (snapshot.completed - snapshot.errors) / snapshot.interval_s;
+    snapshot.error_rate = snapshot.errors / snapshot.interval_s;
+  }
+  snapshot.latency = std::move(latency);
+  last_time_ = now;
+  last_sent_ = sent;
+  last_completed_ = completed;
+  last_dropped_ = dropped;
+  last_errors_ = errors;
+
+  for (auto& listener : listeners_) {
+    listener(snapshot);
+  }
+  if (file_) {
+    write(snapshot);
+  }
+}
+
+void IntervalReporter::write(const IntervalSnapshot& snapshot) {
+  const auto& latency = *snapshot.latency;
+  auto quantiles = latency.getQuantiles(kIntervalQuantiles);
+  if (format_ == Format::JSON) {
+    folly::dynamic latency_dyn = folly::dynamic::object(
+        "count", static_cast<int64_t>(latency.getCount()))(
+        "avg", latency.getMean());
+    for (size_t i = 0; i < kIntervalQuantiles.size(); ++i) {
+      latency_dyn[quantileName(kIntervalQuantiles[i])] = quantiles[i];
+    }
+    folly::dynamic record = folly::dynamic::object("time", snapshot.time)(
+        "elapsed_s", snapshot.elapsed_s)("interval_s", snapshot.interval_s)(
+        "sent", snapshot.sent)("completed", snapshot.completed)(
+        "dropped", snapshot.dropped)("errors", snapshot.errors)(
+        "outstanding", snapshot.outstanding)("sent_rate", snapshot.sent_rate)(
+        "throughput", snapshot.throughput)(
+        "success_rate", snapshot.success_rate)(
+        "error_rate", snapshot.error_rate)("latency", std::move(latency_dyn));
+    fprintf(file_, "%s\n", folly::toJson(record).c_str());
+  } else {
+    std::string line = folly::sformat(
+        "{:.3f},{:.3f},{:.3f},{},{},{},{},{},{:.2f},{:.2f},{:.2f},{:.2f},{},"
+        "{:.2f}",
+        snapshot.time,
+        snapshot.elapsed_s,
+        snapshot.interval_s,
+        snapshot.sent,
+        snapshot.completed,
+        snapshot.dropped,
+        snapshot.errors,
+        snapshot.outstanding,
+        snapshot.sent_rate,
+        snapshot.throughput,
+        snapshot.success_rate,
+        snapshot.error_rate,
+        latency.getCount(),
+        latency.getMean());
+    for (auto value : quantiles) {
+      line += folly::sformat(",{:.2f}", value);
+    }
+    fprintf(file_, "%s\n", line.c_str());
+  }
+  fflush(file_);
+}
+
+LiveStatistics::LiveStatistics(
+    size_t max_intervals,
+    int significant_bits,
+    size_t max_slow_requests)
+    : max_intervals_(max_intervals),
+      max_slow_requests_(max_slow_requests),
+      cumulative_latency_(std::make_shared<Histogram>(significant_bits)) {}
+
+void LiveStatistics::publish(const IntervalSnapshot& snapshot) {
+  // Build the new cumulative histogram outside the lock; readers holding the
+  // previous one keep it alive.
+  auto cumulative = std::make_shared<Histogram>(*getCumulativeLatency());
+  cumulative->merge(*snapshot.latency);
+
+  std::lock_guard<std::mutex> guard(mutex_);
+  intervals_.push_back(snapshot);
+  while (intervals_.size() > max_intervals_) {
+    intervals_.pop_front();
+  }
+  cumulative_latency_ = std::move(cumulative);
+  mergeSlowRequests(
+      slowest_requests_, snapshot.slow_requests, max_slow_requests_);
+}
+
+std::vector<IntervalSnapshot> LiveStatistics::getIntervals(size_t n) const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  n = std::min(n, intervals_.size());
+  return std::vector<IntervalSnapshot>(intervals_.end() - n, intervals_.end());
+}
+
+std::shared_ptr<const Histogram> LiveStatistics::getCumulativeLatency() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return cumulative_latency_;
+}
+
+std::vector<SlowRequest> LiveStatistics::getSlowestRequests() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return slowest_requests_;
+}
+
+} // namespace treadmill
+} // namespace windtunnel
+} // namespace facebook
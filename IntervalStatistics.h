@@ -0,0 +1,289 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "treadmill/Histogram.h"
+#include "treadmill/SlowRequests.h"
+
+namespace facebook {
+namespace windtunnel {
+namespace treadmill {
+
+/**
+ * Statistics of one worker for the current reporting interval.
+ *
+ * All the recording functions are called from the worker thread only. The
+ * counters are cumulative and written with plain relaxed stores, so recording
+ * never needs a read-modify-write on memory another thread writes to. Latency
+ * goes into one of two histograms; the reporter flips the active one and
+ * drains the other, so it never contends with the worker on the same buckets.
+ * The slowest requests of the interval go into a small reservoir.
+ *
+ * Being padded to a cache line of their own, the counters double as the
+ * workers' cheap per-thread feed of the throughput meter: the reporter samples
+ * them on a fixed period and turns the differences into rates.
+ */
+class alignas(64) WorkerIntervalStatistics {
+ public:
+  WorkerIntervalStatistics(int significant_bits, size_t slow_requests)
+      : latency_{{Histogram(significant_bits), Histogram(significant_bits)}},
+        slow_requests_(slow_requests),
+        slow_request_capacity_(slow_requests) {}
+
+  void addLatency(double latency) {
+    latency_[active_.load(std::memory_order_relaxed)].addValue(latency);
+  }
+
+  void addSent() {
+    bump(sent_);
+  }
+
+  void addCompleted(bool error) {
+    bump(completed_);
+    if (error) {
+      bump(errors_);
+    }
+  }
+
+  // Whether a request this slow should be passed to addSlowRequest()
+  bool isSlowRequest(double latency) const {
+    return slow_requests_.admits(latency);
+  }
+
+  void addSlowRequest(const SlowRequest& request) {
+    slow_requests_.add(request);
+  }
+
+  void addDropped() {
+    bump(dropped_);
+  }
+
+  void setOutstanding(int64_t outstanding) {
+    outstanding_.store(outstanding, std::memory_order_relaxed);
+  }
+
+  // Index of the phase the worker records statistics in
+  void setPhase(size_t phase) {
+    phase_.store(phase, std::memory_order_relaxed);
+  }
+
+  int64_t getSent() const {
+    return sent_.load(std::memory_order_relaxed);
+  }
+
+  int64_t getCompleted() const {
+    return completed_.load(std::memory_order_relaxed);
+  }
+
+  int64_t getDropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+  int64_t getErrors() const {
+    return errors_.load(std::memory_order_relaxed);
+  }
+
+  int64_t getOutstanding() const {
+    return outstanding_.load(std::memory_order_relaxed);
+  }
+
+  size_t getPhase() const {
+    return phase_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Switch the worker to the other latency histogram and move the samples of
+   * the previous one into target. Samples the worker was recording into the
+   * previous histogram while we switched stay there and are picked up by the
+   * next rotation.
+   */
+  void rotateInto(Histogram& target) {
+    auto previous = active_.load(std::memory_order_relaxed);
+    active_.store(previous ^ 1, std::memory_order_relaxed);
+    latency_[previous].drainInto(target);
+  }
+
+  std::vector<SlowRequest> drainSlowRequests() {
+    return slow_requests_.drain();
+  }
+
+  size_t getSlowRequestCapacity() const {
+    return slow_request_capacity_;
+  }
+
+ private:
+  static void bump(std::atomic<int64_t>& counter) {
+    counter.store(
+        counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  std::atomic<int> active_{0};
+  std::atomic<int64_t> sent_{0};
+  std::atomic<int64_t> completed_{0};
+  std::atomic<int64_t> dropped_{0};
+  std::atomic<int64_t> errors_{0};
+  std::atomic<int64_t> outstanding_{0};
+  std::atomic<size_t> phase_{0};
+  std::array<Histogram, 2> latency_;
+  SlowRequestReservoir slow_requests_;
+  const size_t slow_request_capacity_;
+};
+
+/**
+ * Cumulative counters of one worker at the end of an interval.
+ */
+struct WorkerSnapshot {
+  int64_t sent;
+  int64_t completed;
+  int64_t dropped;
+  int64_t errors;
+  int64_t outstanding;
+};
+
+/**
+ * Statistics of all workers over one reporting interval. Counts are for the
+ * interval only, except outstanding, which is the value at its end. Rates are
+ * per second; completed requests are either succeeded or failed (errors).
+ */
+struct IntervalSnapshot {
+  // Number of the interval since the start of the run
+  int64_t sequence{0};
+  // Phase of the first worker at the end of the interval
+  size_t phase{0};
+  double time{0};
+  double elapsed_s{0};
+  double interval_s{0};
+  int64_t sent{0};
+  int64_t completed{0};
+  int64_t dropped{0};
+  int64_t errors{0};
+  int64_t outstanding{0};
+  double sent_rate{0};
+  // Completed requests per second
+  double throughput{0};
+  double success_rate{0};
+  double error_rate{0};
+  std::shared_ptr<const Histogram> latency;
+  std::vector<WorkerSnapshot> workers;
+  // Slowest requests of all workers, slowest first
+  std::vector<SlowRequest> slow_requests;
+};
+
+/**
+ * Periodically aggregates the WorkerIntervalStatistics of all workers and
+ * appends one record per interval to a file, either as a JSON object per line
+ * or as CSV, and hands the interval's latency to listeners. All the
+ * aggregation and formatting happens on the reporter's own thread.
+ */
+class IntervalReporter {
+ public:
+  enum class Format { JSON, CSV };
+
+  // Called on the reporter thread at the end of every interval
+  using Listener = std::function<void(const IntervalSnapshot&)>;
+
+  // An empty filename reports to the listeners only.
+  IntervalReporter(
+      std::vector<WorkerIntervalStatistics*> workers,
+      const std::string& filename,
+      Format format,
+      int64_t period_ms,
+      int significant_bits);
+  ~IntervalReporter();
+
+  static Format parseFormat(const std::string& format);
+
+  // Must be called before start().
+  void addListener(Listener listener);
+
+  void start();
+
+  // Writes the final, possibly shorter, interval and joins the thread.
+  void stop();
+
+ private:
+  void loop();
+  void report(int64_t now);
+  void write(const IntervalSnapshot& snapshot);
+
+  std::vector<WorkerIntervalStatistics*> workers_;
+  FILE* file_;
+  Format format_;
+  int64_t period_ns_;
+  int significant_bits_;
+  std::vector<Listener> listeners_;
+
+  int64_t sequence_{0};
+  int64_t start_time_{0};
+  int64_t last_time_{0};
+  int64_t last_sent_{0};
+  int64_t last_completed_{0};
+  int64_t last_dropped_{0};
+  int64_t last_errors_{0};
+
+  std::mutex mutex_;
+  std::condition_variable stop_cv_;
+  bool stopping_{false};
+  std::unique_ptr<std::thread> thread_;
+};
+
+/**
+ * The most recent interval snapshots and the latency over the whole run, for
+ * live queries while the run goes on. The reporter publishes a snapshot per
+ * interval; readers copy out shared pointers under a short lock, so they never
+ * touch the workers' statistics.
+ */
+class LiveStatistics {
+ public:
+  LiveStatistics(
+      size_t max_intervals,
+      int significant_bits,
+      size_t max_slow_requests);
+
+  void publish(const IntervalSnapshot& snapshot);
+
+  // Up to the last n intervals, oldest first.
+  std::vector<IntervalSnapshot> getIntervals(size_t n) const;
+
+  // Latency of every interval published so far
+  std::shared_ptr<const Histogram> getCumulativeLatency() const;
+
+  // Slowest requests of every interval published so far, slowest first
+  std::vector<SlowRequest> getSlowestRequests() const;
+
+  size_t getMaxIntervals() const {
+    return max_intervals_;
+  }
+
+ private:
+  const size_t max_intervals_;
+  const size_t max_slow_requests_;
+  mutable std::mutex mutex_;
+  std::deque<IntervalSnapshot> intervals_;
+  std::shared_ptr<const Histogram> cumulative_latency_;
+  std::vector<SlowRequest> slowest_requests_;
+};
+
+} // namespace treadmill
+} // namespace windtunnel
+} // namespace facebook
@@ -0,0 +1,178 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include "treadmill/KeyChooser.h"
+
+#include <algorithm>
+
+#include <glog/logging.h>
+
+namespace facebook {
+namespace windtunnel {
+namespace treadmill {
+
+namespace {
+
+// log1p(x) / x, accurate around 0
+double log1pOverX(double x) {
+  if (std::abs(x) > 1e-8) {
+    return std::log1p(x) / x;
+  }
+  return 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x));
+}
+
+// expm1(x) / x, accurate around 0
+double expm1OverX(double x) {
+  if (std::abs(x) > 1e-8) {
+    return std::expm1(x) / x;
+  }
+  return 1 + x * 0.5 * (1 + x * (1.0 / 3) * (1 + 0.25 * x));
+}
+
+} // namespace
+
+ZipfDistribution::ZipfDistribution(uint64_t n, double theta)
+    : n_(n), theta_(theta) {
+  CHECK_GT(n, 0);
+  CHECK_GE(theta, 0);
+  h_integral_x1_ = hIntegral(1.5) - 1;
+  h_integral_n_ = hIntegral(n_ + 0.5);
+  s_ = 2 - hIntegralInverse(hIntegral(2.5) - h(2));
+}
+
+double ZipfDistribution::h(double x) const {
+  return std::exp(-theta_ * std::log(x));
+}
+
+double ZipfDistribution::hIntegral(double x) const {
+  double log_x = std::log(x);
+  return expm1OverX((1 - theta_) * log_x) * log_x;
+}
+
+double ZipfDistribution::hIntegralInverse(double x) const {
+  double t = std::max(x * (1 - theta_), -1.0);
+  return std::exp(log1pOverX(t) * x);
+}
+
+KeyChooser::KeyChooser(uint64_t number_of_keys, uint64_t seed)
+    : number_of_keys_(number_of_keys), seed_(seed), engine_(seed) {
+  CHECK_GT(number_of_keys, 0);
+}
+
+/* static */ std::unique_ptr<KeyChooser> KeyChooser::make(
+    const folly::dynamic& config,
+    uint64_t number_of_keys,
+    uint64_t seed) {
+  auto type = config.getDefault("type", "sequential").asString();
+  if (type == "sequential") {
+    return std::make_unique<SequentialKeyChooser>(number_of_keys, seed);
+  } else if (type == "uniform") {
+    return std::make_unique<UniformKeyChooser>(number_of_keys, seed);
+  } else if (type == "zipf") {
+    return std::make_unique<ZipfKeyChooser>(
+        number_of_keys, seed, config.getDefault("theta", 0.99).asDouble());
+  } else if (type == "hotspot") {
+    return std::make_unique<HotspotKeyChooser>(
+        number_of_keys,
+        seed,
+        config.getDefault("hot_fraction", 0.2).asDouble(),
+        config.getDefault("hot_probability", 0.8).asDouble());
+  } else if (type == "latest") {
+    return std::make_unique<LatestKeyChooser>(
+        number_of_keys, seed, config.getDefault("theta", 0.99).asDouble());
+  }
+  LOG(FATAL) << "Unknown key distribution: " << type;
+  return nullptr;
+}
+
+SequentialKeyChooser::SequentialKeyChooser(
+    uint64_t number_of_keys,
+    uint64_t seed)
+    : KeyChooser(number_of_keys, seed) {}
+
+uint64_t SequentialKeyChooser::next() {
+  auto key = index_;
+  if (++index_ == number_of_keys_) {
+    index_ = 0;
+  }
+  return key;
+}
+
+void SequentialKeyChooser::reset() {
+  KeyChooser::reset();
+  index_ = 0;
+}
+
+UniformKeyChooser::UniformKeyChooser(uint64_t number_of_keys, uint64_t seed)
+    : KeyChooser(number_of_keys, seed) {}
+
+uint64_t UniformKeyChooser::next() {
+  return nextBelow(number_of_keys_);
+}
+
+ZipfKeyChooser::ZipfKeyChooser(
+    uint64_t number_of_keys,
+    uint64_t seed,
+    double theta)
+    : KeyChooser(number_of_keys, seed), zipf_(number_of_keys, theta) {}
+
+uint64_t ZipfKeyChooser::next() {
+  return zipf_(engine_) - 1;
+}
+
+HotspotKeyChooser::HotspotKeyChooser(
+    uint64_t number_of_keys,
+    uint64_t seed,
+    double hot_fraction,
+    double hot_probability)
+    : KeyChooser(number_of_keys, seed),
+      hot_keys_(std::min(
+          number_of_keys,
+          std::max<uint64_t>(1, number_of_keys * hot_fraction))),
+      hot_probability_(hot_probability) {
+  CHECK(hot_fraction >= 0 && hot_fraction <= 1);
+  CHECK(hot_probability >= 0 && hot_probability <= 1);
+}
+
+uint64_t HotspotKeyChooser::next() {
+  if (hot_keys_ == number_of_keys_ || nextDouble() < hot_probability_) {
+    return nextBelow(hot_keys_);
+  }
+  return hot_keys_ + nextBelow(number_of_keys_ - hot_keys_);
+}
+
+LatestKeyChooser::LatestKeyChooser(
+    uint64_t number_of_keys,
+    uint64_t seed,
+    double theta)
+    : KeyChooser(number_of_keys, seed),
+      zipf_(number_of_keys, theta),
+      latest_(number_of_keys - 1) {}
+
+uint64_t LatestKeyChooser::next() {
+  // Rank 1 is the latest key, rank 2 the one written before it, and so on,
+  // wrapping around the key space.
+  auto distance = zipf_(engine_) - 1;
+  return latest_ >= distance ? latest_ - distance
+                             : latest_ + number_of_keys_ - distance;
+}
+
+void LatestKeyChooser::recordWrite(uint64_t key) {
+  latest_ = key;
+}
+
+void LatestKeyChooser::reset() {
+  KeyChooser::reset();
+  latest_ = number_of_keys_ - 1;
+}
+
+} // namespace treadmill
+} // namespace windtunnel
+} // namespace facebook
@@ -0,0 +1,201 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+
+#include <folly/dynamic.h>
+
+#include "treadmill/Xoshiro256.h"
+
+namespace facebook {
+namespace windtunnel {
+namespace treadmill {
+
+/**
+ * Zipf distribution over the ranks [1, n], P(k) proportional to k^-theta,
+ * sampled by rejection-inversion (Hörmann and Derflinger, "Rejection-inversion
+ * to generate variates from monotone discrete distributions", 1996).
+ *
+ * Needs no tables, so n can be in the billions, and takes O(1) time per draw:
+ * one exp and one log1p, plus a second pair in the rare draws that fall
+ * outside the fast acceptance region around each rank. Any theta >= 0 works,
+ * including 1.
+ */
+class ZipfDistribution {
+ public:
+  ZipfDistribution(uint64_t n, double theta);
+
+  // A rank in [1, n]
+  template <class Engine>
+  uint64_t operator()(Engine& engine) {
+    while (true) {
+      double u =
+          h_integral_n_ + uniform(engine) * (h_integral_x1_ - h_integral_n_);
+      double x = hIntegralInverse(u);
+      double k = std::floor(x + 0.5);
+      if (k < 1) {
+        k = 1;
+      } else if (k > n_) {
+        k = n_;
+      }
+      // Fast path: k is close enough to x to be accepted without computing
+      // the integral at k.
+      if (k - x <= s_ || u >= hIntegral(k + 0.5) - h(k)) {
+        return uint64_t(k);
+      }
+    }
+  }
+
+ private:
+  template <class Engine>
+  static double uniform(Engine& engine) {
+    return (engine() >> 11) * 0x1.0p-53;
+  }
+
+  // h(x) = x^-theta, and its integral H and the inverse of H
+  double h(double x) const;
+  double hIntegral(double x) const;
+  double hIntegralInverse(double x) const;
+
+  double n_;
+  double theta_;
+  double h_integral_x1_;
+  double h_integral_n_;
+  double s_;
+};
+
+/**
+ * Chooses which key, out of number_of_keys, each request of a workload goes
+ * to. Every worker has its own chooser, so choosers aren't thread-safe, and
+ * none of them keeps state per key.
+ */
+class KeyChooser {
+ public:
+  virtual ~KeyChooser() = default;
+
+  /**
+   * Make a chooser from the workload config, e.g.
+   *   {"type": "zipf", "theta": 0.99}
+   * Types and their parameters:
+   *   sequential  every key in turn (the default)
+   *   uniform     every key equally likely
+   *   zipf        key i with probability proportional to (i + 1)^-theta
+   *   hotspot     hot_probability of the requests go uniformly to the first
+   *               hot_fraction of the keys, the rest to the other keys
+   *   latest      Zipf with the given theta over how recently keys were
+   *               written, the most recently written key being the most
+   *               popular
+   */
+  static std::unique_ptr<KeyChooser> make(
+      const folly::dynamic& config,
+      uint64_t number_of_keys,
+      uint64_t seed);
+
+  // A key in [0, number_of_keys)
+  virtual uint64_t next() = 0;
+
+  // Tell the chooser that key was written.
+  virtual void recordWrite(uint64_t /*key*/) {}
+
+  // Start over with the sequence of keys chosen since construction.
+  virtual void reset() {
+    engine_.seed(seed_);
+  }
+
+  // Start over with another seed.
+  void seed(uint64_t seed) {
+    seed_ = seed;
+    reset();
+  }
+
+  uint64_t getNumberOfKeys() const {
+    return number_of_keys_;
+  }
+
+ protected:
+  KeyChooser(uint64_t number_of_keys, uint64_t seed);
+
+  // Uniform in [0, n), without division
+  uint64_t nextBelow(uint64_t n) {
+    return uint64_t((unsigned __int128)engine_() * n >> 64);
+  }
+
+  double nextDouble() {
+    return (engine_() >> 11) * 0x1.0p-53;
+  }
+
+  const uint64_t number_of_keys_;
+  uint64_t seed_;
+  Xoshiro256 engine_;
+};
+
+class SequentialKeyChooser : public KeyChooser {
+ public:
+  SequentialKeyChooser(uint64_t number_of_keys, uint64_t seed);
+
+  uint64_t next() override;
+  void reset() override;
+
+ private:
+  uint64_t index_{0};
+};
+
+class UniformKeyChooser : public KeyChooser {
+ public:
+  UniformKeyChooser(uint64_t number_of_keys, uint64_t seed);
+
+  uint64_t next() override;
+};
+
+class ZipfKeyChooser : public KeyChooser {
+ public:
+  ZipfKeyChooser(uint64_t number_of_keys, uint64_t seed, double theta);
+
+  uint64_t next() override;
+
+ private:
+  ZipfDistribution zipf_;
+};
+
+class HotspotKeyChooser : public KeyChooser {
+ public:
+  HotspotKeyChooser(
+      uint64_t number_of_keys,
+      uint64_t seed,
+      double hot_fraction,
+      double hot_probability);
+
+  uint64_t next() override;
+
+ private:
+  const uint64_t hot_keys_;
+  const double hot_probability_;
+};
+
+class LatestKeyChooser : public KeyChooser {
+ public:
+  LatestKeyChooser(uint64_t number_of_keys, uint64_t seed, double theta);
+
+  uint64_t next() override;
+  void recordWrite(uint64_t key) override;
+  void reset() override;
+
+ private:
+  ZipfDistribution zipf_;
+  uint64_t latest_;
+};
+
+} // namespace treadmill
+} // namespace windtunnel
+} // namespace facebook
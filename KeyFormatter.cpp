@@ -0,0 +1,120 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include "treadmill/KeyFormatter.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <folly/Conv.h>
+#include <glog/logging.h>
+
+namespace facebook {
+namespace windtunnel {
+namespace treadmill {
+
+namespace {
+
+char getPadding(const folly::dynamic& config) {
+  auto padding = config.getDefault("padding", "0").asString();
+  CHECK_EQ(padding.size(), 1) << "Key padding must be one character";
+  return padding[0];
+}
+
+} // namespace
+
+KeyFormatter::KeyFormatter(
+    const folly::dynamic& config,
+    uint64_t number_of_keys)
+    : prefix_(config.getDefault("prefix", "").asString()),
+      width_(config.getDefault("width", 0).asInt()),
+      padding_(getPadding(config)) {
+  CHECK_GT(number_of_keys, 0);
+  max_size_ = prefix_.size() +
+      std::max<size_t>(width_, folly::digits10(number_of_keys - 1));
+  CHECK_LE(max_size_, kMaxKeySize) << "Keys would be too long";
+}
+
+/* static */ std::shared_ptr<const KeyArena> KeyFormatter::makeArena(
+    const folly::dynamic& config,
+    uint64_t number_of_keys) {
+  if (!config.getDefault("precompute", false).asBool()) {
+    return nullptr;
+  }
+  KeyFormatter formatter(config, number_of_keys);
+  const size_t stride = formatter.max_size_;
+  uint64_t max_arena_mb = config.getDefault("max_arena_mb", 1024).asInt();
+  if (number_of_keys * stride > max_arena_mb << 20) {
+    LOG(WARNING) << "Not precomputing keys: " << number_of_keys
+                 << " keys would take more than " << max_arena_mb << " MB";
+    return nullptr;
+  }
+
+  auto arena = std::make_shared<KeyArena>();
+  arena->stride = stride;
+  arena->data.resize(number_of_keys * stride);
+  bool fixed_length = formatter.width_ >=
+      static_cast<size_t>(folly::digits10(number_of_keys - 1));
+  if (!fixed_length) {
+    arena->lengths.resize(number_of_keys);
+  }
+  for (uint64_t key = 0; key < number_of_keys; key++) {
+    size_t length = formatter.write(key, arena->data.data() + key * stride);
+    if (!fixed_length) {
+      arena->lengths[key] = length;
+    }
+  }
+  LOG(INFO) << "Precomputed " << number_of_keys << " keys in "
+            << arena->data.size() + arena->lengths.size() << " bytes";
+  return arena;
+}
+
+void KeyFormatter::setArena(std::shared_ptr<const KeyArena> arena) {
+  CHECK(!arena || arena->stride == max_size_)
+      << "The arena was made for another key format";
+  arena_ = std::move(arena);
+}
+
+folly::IOBuf KeyFormatter::format(uint64_t key) {
+  if (arena_) {
+    DCHECK_LT(key * arena_->stride, arena_->data.size());
+    return folly::IOBuf(
+        folly::IOBuf::WRAP_BUFFER,
+        arena_->data.data() + key * arena_->stride,
+        arena_->lengths.empty() ? arena_->stride : arena_->lengths[key]);
+  }
+  if (!slab_ || slab_->tailroom() < max_size_) {
+    slab_ = folly::IOBuf::create(kSlabSize);
+  }
+  size_t length = write(key, reinterpret_cast<char*>(slab_->writableTail()));
+  slab_->append(length);
+  // Shares the slab: a reference count increment, not an allocation
+  folly::IOBuf formatted = slab_->cloneOneAsValue();
+  formatted.trimStart(formatted.length() - length);
+  return formatted;
+}
+
+size_t KeyFormatter::write(uint64_t key, char* out) const {
+  char digits[20];
+  size_t length = folly::uint64ToBufferUnsafe(key, digits);
+  char* p = out;
+  memcpy(p, prefix_.data(), prefix_.size());
+  p += prefix_.size();
+  if (length < width_) {
+    memset(p, padding_, width_ - length);
+    p += width_ - length;
+  }
+  memcpy(p, digits, length);
+  return p + length - out;
+}
+
+} // namespace treadmill
+} // namespace windtunnel
+} // namespace facebook
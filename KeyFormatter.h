@@ -0,0 +1,102 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <folly/dynamic.h>
+#include <folly/io/IOBuf.h>
+
+namespace facebook {
+namespace windtunnel {
+namespace treadmill {
+
+/**
+ * Every key of a keyspace, formatted once and shared by the workers. Keys are
+ * stride bytes apart; when they aren't all as long as the stride, lengths
+ * holds the length of each.
+ */
+struct KeyArena {
+  std::vector<char> data;
+  size_t stride;
+  std::vector<uint8_t> lengths;
+};
+
+/**
+ * Turns the key numbers a KeyChooser draws into the keys sent to the server:
+ * a prefix, then the number in decimal, left-padded to a minimum width.
+ *
+ * format() returns IOBufs that share memory instead of owning a copy, so they
+ * can be handed down to the protocol library as they are. Keys are either
+ * written one after the other into a slab the formatter reuses until it's
+ * full, or point into a precomputed KeyArena that was set with setArena().
+ * Every worker has its own formatter, which isn't thread-safe.
+ */
+class KeyFormatter {
+ public:
+  // Memcached's limit
+  static constexpr size_t kMaxKeySize = 250;
+
+  /**
+   * Make a formatter from the workload config, e.g.
+   *   {"prefix": "user:", "width": 12, "padding": "0", "precompute": true}
+   * All fields are optional: by default, keys are bare numbers. precompute
+   * is for makeArena().
+   */
+  KeyFormatter(const folly::dynamic& config, uint64_t number_of_keys);
+
+  /**
+   * All number_of_keys keys of the same config, for formatters to share; or
+   * nullptr if config doesn't ask for precompute, or if the keys would take
+   * more than config["max_arena_mb"] (default 1024) of memory. The memory is
+   * allocated by the calling thread.
+   */
+  static std::shared_ptr<const KeyArena> makeArena(
+      const folly::dynamic& config,
+      uint64_t number_of_keys);
+
+  // Serve keys from arena, from makeArena() with the same config, from now on
+  void setArena(std::shared_ptr<const KeyArena> arena);
+
+  // The key for key number key
+  folly::IOBuf format(uint64_t key);
+
+  // Writes the key into out, which must have getMaxSize() bytes of room, and
+  // returns its length.
+  size_t write(uint64_t key, char* out) const;
+
+  size_t getMaxSize() const {
+    return max_size_;
+  }
+
+  bool isPrecomputed() const {
+    return arena_ != nullptr;
+  }
+
+ private:
+  static constexpr size_t kSlabSize = 64 * 1024;
+
+  const std::string prefix_;
+  const size_t width_;
+  const char padding_;
+  size_t max_size_;
+  std::shared_ptr<const KeyArena> arena_;
+  // Keys are formatted at its tail; replaced once it's full, while requests
+  // still hold on to the old one.
+  std::unique_ptr<folly::IOBuf> slab_;
+};
+
+} // namespace treadmill
+} // namespace windtunnel
+} // namespace facebook
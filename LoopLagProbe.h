@@ -0,0 +1,63 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+
+#include <folly/io/async/AsyncTimeout.h>
+#include <folly/io/async/EventBase.h>
+
+#include "treadmill/StatisticsManager.h"
+#include "treadmill/Util.h"
+
+namespace facebook {
+namespace windtunnel {
+namespace treadmill {
+
+/**
+ * Measures how long work that becomes ready waits before an EventBase gets to
+ * run it. Replies are completed by callbacks on the worker's EventBase, so
+ * this is the delay of reply continuations: a timeout is scheduled every
+ * period and the time it fires late is recorded, in nanoseconds.
+ *
+ * Must be started and destroyed on the EventBase's thread.
+ */
+class LoopLagProbe : private folly::AsyncTimeout {
+ public:
+  LoopLagProbe(
+      folly::EventBase& event_base,
+      StatisticsManager::Histogram* histogram,
+      int64_t period_us)
+      : folly::AsyncTimeout(&event_base),
+        histogram_(histogram),
+        period_us_(period_us) {}
+
+  void start() {
+    expected_time_ = nowNs() + period_us_ * 1000;
+    scheduleTimeoutHighRes(std::chrono::microseconds(period_us_));
+  }
+
+ private:
+  void timeoutExpired() noexcept override {
+    auto lag = std::max<int64_t>(nowNs() - expected_time_, 0);
+    histogram_->addValue(lag);
+    start();
+  }
+
+  StatisticsManager::Histogram* histogram_;
+  const int64_t period_us_;
+  int64_t expected_time_{0};
+};
+
+} // namespace treadmill
+} // namespace windtunnel
+} // namespace facebook
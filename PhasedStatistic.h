@@ -0,0 +1,153 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include <folly/Likely.h>
+
+#include "treadmill/CounterStatistic.h"
+#include "treadmill/Histogram.h"
+
+namespace facebook {
+namespace windtunnel {
+namespace treadmill {
+
+// Maximum number of distinct phases in a run, including the default phase.
+constexpr size_t kMaxPhases = 16;
+
+/**
+ * Index of the phase that statistics recorded by the calling thread are
+ * attributed to. Workers set it when they process a SET_PHASE event; threads
+ * that never do record into phase 0.
+ */
+inline size_t& currentPhase() {
+  static thread_local size_t phase = 0;
+  return phase;
+}
+
+/**
+ * A statistic partitioned by phase. The instance of a phase is created the
+ * first time something is recorded in it, and published with a single atomic
+ * store, so recording only costs a thread-local read and an acquire load on
+ * top of recording into T.
+ */
+template <class T>
+class PhasedStatistic {
+ public:
+  using Factory = std::function<std::unique_ptr<T>()>;
+
+  explicit PhasedStatistic(Factory factory) : factory_(std::move(factory)) {
+    for (auto& stat : phases_) {
+      stat.store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  PhasedStatistic(const PhasedStatistic&) = delete;
+  PhasedStatistic& operator=(const PhasedStatistic&) = delete;
+
+  ~PhasedStatistic() {
+    for (auto& stat : phases_) {
+      delete stat.load(std::memory_order_relaxed);
+    }
+  }
+
+  T& current() {
+    return forPhase(currentPhase());
+  }
+
+  T& forPhase(size_t phase) {
+    auto stat = phases_[phase].load(std::memory_order_acquire);
+    return LIKELY(stat != nullptr) ? *stat : create(phase);
+  }
+
+  // The instance of a phase, or nullptr if nothing was recorded in it.
+  const T* getPhase(size_t phase) const {
+    return phases_[phase].load(std::memory_order_acquire);
+  }
+
+ private:
+  T& create(size_t phase) {
+    auto stat = factory_().release();
+    T* expected = nullptr;
+    if (!phases_[phase].compare_exchange_strong(
+            expected, stat, std::memory_order_acq_rel)) {
+      // Another thread created it first.
+      delete stat;
+      return *expected;
+    }
+    return *stat;
+  }
+
+  Factory factory_;
+  std::array<std::atomic<T*>, kMaxPhases> phases_;
+};
+
+class PhasedHistogram : public PhasedStatistic<Histogram> {
+ public:
+  explicit PhasedHistogram(int significant_bits)
+      : PhasedStatistic<Histogram>([significant_bits] {
+          return std::make_unique<Histogram>(significant_bits);
+        }),
+        significant_bits_(significant_bits) {}
+
+  void addValue(double value) {
+    current().addValue(value);
+  }
+
+  void addValue(double value, uint64_t count) {
+    current().addValue(value, count);
+  }
+
+  // All phases merged into one histogram.
+  Histogram merged() const {
+    Histogram result(significant_bits_);
+    for (size_t phase = 0; phase < kMaxPhases; ++phase) {
+      if (auto histogram = getPhase(phase)) {
+        result.merge(*histogram);
+      }
+    }
+    return result;
+  }
+
+ private:
+  int significant_bits_;
+};
+
+class PhasedCounter : public PhasedStatistic<CounterStatistic> {
+ public:
+  explicit PhasedCounter(const std::string& name)
+      : PhasedStatistic<CounterStatistic>(
+            [name] { return std::make_unique<CounterStatistic>(name); }) {}
+
+  void increase(int64_t n, const std::string& subkey = "") {
+    current().increase(n, subkey);
+  }
+
+  // Count over all phases.
+  int64_t getCount() const {
+    int64_t count = 0;
+    for (size_t phase = 0; phase < kMaxPhases; ++phase) {
+      if (auto counter = getPhase(phase)) {
+        count += counter->getCount();
+      }
+    }
+    return count;
+  }
+};
+
+} // namespace treadmill
+} // namespace windtunnel
+} // namespace facebook
@@ -10,75 +10,123 @@
 #include "treadmill/RandomEngine.h"
 
 #include <sys/time.h>
-#include <thread>
+
+#include <random>
 
 #include <folly/Likely.h>
+#include <glog/logging.h>
 
 DEFINE_uint64(treadmill_random_seed, ULLONG_MAX, "seed for random engines");
 
-using std::mt19937_64;
-using std::uniform_int_distribution;
-using std::uniform_real_distribution;
-
 namespace facebook {
 namespace windtunnel {
 namespace treadmill {
 
-// Seed the random engine
-mt19937_64 RandomEngine::random_engine_(
-    FLAGS_treadmill_random_seed == ULLONG_MAX ? time(nullptr)
-                                              : FLAGS_treadmill_random_seed);
-// Generate a uniform distribution
-uniform_real_distribution<double> RandomEngine::uniform_real_distribution_(
-    0.0,
-    1.0);
-uniform_int_distribution<uint64_t> RandomEngine::uniform_int_distribution_(
-    0,
-    ULLONG_MAX);
-
-// Empty thread-local random engine
-folly::ThreadLocalPtr<std::mt19937_64> ThreadSafeRandomEngine::random_engine_;
+namespace {
+
+uint64_t splitmix64(uint64_t x) {
+  x += 0x9e3779b97f4a7c15;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+  return x ^ (x >> 31);
+}
+
+// Stream of the shared engine, out of the way of the thread streams
+constexpr uint64_t kSharedStream = ULLONG_MAX;
+
+} // namespace
+
+// Empty thread-local streams, seeded on first use
+folly::ThreadLocalPtr<ThreadSafeRandomEngine::Stream>
+    ThreadSafeRandomEngine::stream_;
+Xoshiro256 ThreadSafeRandomEngine::next_stream_;
+bool ThreadSafeRandomEngine::next_stream_seeded_ = false;
+std::mutex ThreadSafeRandomEngine::next_stream_mutex_;
+
+uint64_t RandomEngine::getSeed() {
+  // Not resolved before first use, so that it's after flags are parsed
+  static const uint64_t seed = [] {
+    if (FLAGS_treadmill_random_seed != ULLONG_MAX) {
+      return uint64_t(FLAGS_treadmill_random_seed);
+    }
+    std::random_device device;
+    // Small enough to type back in
+    uint64_t picked = device();
+    LOG(INFO) << "Random seed: " << picked
+              << "; rerun with --treadmill_random_seed=" << picked
+              << " to repeat";
+    return picked;
+  }();
+  return seed;
+}
+
+uint64_t RandomEngine::deriveSeed(uint64_t seed, uint64_t stream_id) {
+  return splitmix64(seed ^ splitmix64(stream_id));
+}
+
+Xoshiro256& RandomEngine::get() {
+  static Xoshiro256 engine(deriveSeed(getSeed(), kSharedStream));
+  return engine;
+}
 
 double RandomEngine::getDouble() {
-  return uniform_real_distribution_(random_engine_);
+  return Xoshiro256::toUniform(get()());
 }
 
 double RandomEngine::getDouble(double min, double max) {
-  uniform_real_distribution<double> dist(min, max);
-  return dist(random_engine_);
+  return min + getDouble() * (max - min);
 }
 
 uint64_t RandomEngine::getInteger() {
-  return uniform_int_distribution_(random_engine_);
+  return get()();
 }
 
 uint64_t RandomEngine::getInteger(uint64_t min, uint64_t max) {
-  uniform_int_distribution<uint64_t> dist(min, max);
-  return dist(random_engine_);
+  return Xoshiro256::toInteger(get()(), min, max);
 }
 
-mt19937_64& ThreadSafeRandomEngine::get() {
-  mt19937_64* engine = random_engine_.get();
-  if (UNLIKELY(engine == nullptr)) {
-    std::hash<std::thread::id> hasher;
-    uint64_t seed = hasher(std::this_thread::get_id()) +
-        (FLAGS_treadmill_random_seed == ULLONG_MAX
-             ? time(nullptr)
-             : FLAGS_treadmill_random_seed);
-    engine = new mt19937_64(seed);
-    random_engine_.reset(engine);
+ThreadSafeRandomEngine::Stream& ThreadSafeRandomEngine::get() {
+  Stream* stream = stream_.get();
+  if (UNLIKELY(stream == nullptr)) {
+    std::lock_guard<std::mutex> lock(next_stream_mutex_);
+    if (!next_stream_seeded_) {
+      next_stream_.seed(RandomEngine::getSeed());
+      next_stream_.longJump();
+      next_stream_seeded_ = true;
+    }
+    stream = new Stream(next_stream_);
+    next_stream_.jump();
+    stream_.reset(stream);
   }
-  return *engine;
+  return *stream;
 }
 
 double ThreadSafeRandomEngine::getDouble(double min, double max) {
-  uniform_real_distribution<double> dist(min, max);
-  return dist(get());
+  return min + Xoshiro256::toUniform(get().engine()) * (max - min);
 }
 
 uint64_t ThreadSafeRandomEngine::getInteger(uint64_t min, uint64_t max) {
-  uniform_int_distribution<uint64_t> dist(min, max);
-  return dist(get());
+  return Xoshiro256::toInteger(get().engine(), min, max);
+}
+
+double ThreadSafeRandomEngine::getExponential(double mean) {
+  Stream& stream = get();
+  constexpr size_t kBatch =
+      sizeof(stream.exponentials) / sizeof(stream.exponentials[0]);
+  if (UNLIKELY(stream.next == kBatch)) {
+    stream.engine.fillExponential(stream.exponentials, kBatch, 1.0);
+    stream.next = 0;
+  }
+  return stream.exponentials[stream.next++] * mean;
+}
+
+void ThreadSafeRandomEngine::setStream(uint64_t stream_id) {
+  // Stream i starts i jumps of 2^128 draws into the master sequence.
+  Xoshiro256 engine(RandomEngine::getSeed());
+  for (uint64_t i = 0; i < stream_id; i++) {
+    engine.jump();
+  }
+  stream_.reset(new Stream(engine));
 }
 
 } // namespace treadmill
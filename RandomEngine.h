@@ -9,10 +9,13 @@
  */
 #pragma once
 
-#include <random>
+#include <cstdint>
+#include <mutex>
 
 #include <folly/ThreadLocal.h>
 
+#include "treadmill/Xoshiro256.h"
+
 DECLARE_uint64(treadmill_random_seed);
 
 namespace facebook {
@@ -20,20 +23,18 @@ namespace windtunnel {
 namespace treadmill {
 
 /**
- * Shared struct for Mersene Twister 19937 generator (64 bit)
+ * Shared struct for the xoshiro256** generator
  *
- * The struct produces a shared random number stream that all threads can
- * access.
- * The struct might not be thread-safe or have high locking contention depending
- * on the underlying STL implementation.
- * If you want a thread-safe PRNG for each thread, use ThreadSafeRandomEngine.
+ * The struct produces a single random number stream from one static generator,
+ * with no locking. It is not thread-safe: only use it from one thread at a
+ * time. For a PRNG per thread, use ThreadSafeRandomEngine.
  */
 struct RandomEngine {
  public:
   /**
-   * Return a random number ranging in [0.0, 1.0] in double
+   * Return a random number ranging in (0.0, 1.0) in double
    *
-   * @return A random number ranging in [0.0, 1.0] in double
+   * @return A random number ranging in (0.0, 1.0) in double
    */
   static double getDouble();
 
@@ -58,24 +59,42 @@ struct RandomEngine {
    */
   static uint64_t getInteger(uint64_t min, uint64_t max);
 
+  /**
+   * Return the master seed that every random stream of the run derives from:
+   * --treadmill_random_seed, or if it's unset, a seed picked on first use
+   * and logged so that the run can be repeated
+   *
+   * @return The master seed
+   */
+  static uint64_t getSeed();
+
+  /**
+   * Return the seed of stream stream_id of seed, so that one seed yields
+   * any number of unrelated ones, e.g. one for every worker and, from
+   * those, one for every random choice a workload makes
+   *
+   * @return The seed of the stream
+   */
+  static uint64_t deriveSeed(uint64_t seed, uint64_t stream_id);
+
  private:
-  // The Mersene Twister 19937 random engine (64 bit)
-  static std::mt19937_64 random_engine_;
-  // A uniform distribution for real numbers
-  static std::uniform_real_distribution<double> uniform_real_distribution_;
-  // A uniform distribution for integer numbers
-  static std::uniform_int_distribution<uint64_t> uniform_int_distribution_;
+  /**
+   * Return the underlying random engine
+   *
+   * @return The underlying random engine
+   */
+  static Xoshiro256& get();
 };
 
 /**
- * Thread-local struct for Mersene Twister 19937 generator (64 bit)
+ * Thread-local struct for the xoshiro256** generator
  *
  * This struct produces a private random number stream for current thread.
  * Should perform better than the shared engine.
- * Different threads will have different seeds derived from the global seed and
- * their thread ids.
- * The correlation between streams of all threads might not be 0.
- * Don't use if you have strong requirement on randomness.
+ * All streams derive from the master seed and never overlap. Threads that
+ * call setStream() draw from the same stream in every run with the same
+ * seed; other threads get one in the order they first draw, which isn't
+ * reproducible.
  */
 struct ThreadSafeRandomEngine {
  public:
@@ -93,16 +112,43 @@ struct ThreadSafeRandomEngine {
    */
   static uint64_t getInteger(uint64_t min, uint64_t max);
 
+  /**
+   * Return an exponentially distributed random number with the given mean.
+   * Draws are made in batches, so most calls are a load and a multiply.
+   *
+   * @return An exponentially distributed random number in double
+   */
+  static double getExponential(double mean);
+
+  /**
+   * Make the current thread draw from stream stream_id, from its start. The
+   * scheduler uses stream 0 and worker i stream i + 1.
+   */
+  static void setStream(uint64_t stream_id);
+
  private:
+  struct Stream {
+    explicit Stream(const Xoshiro256& engine) : engine(engine) {}
+
+    Xoshiro256 engine;
+    // Unit mean exponentials, used from next onwards
+    double exponentials[256];
+    size_t next{sizeof(exponentials) / sizeof(exponentials[0])};
+  };
+
   /**
-   * Return the underlying random engine
+   * Return the stream of the current thread
    *
-   * @return The underlying random engine
+   * @return The stream of the current thread
    */
-  static std::mt19937_64& get();
+  static Stream& get();
 
-  // The Mersene Twister 19937 random engine (64 bit)
-  static folly::ThreadLocalPtr<std::mt19937_64> random_engine_;
+  static folly::ThreadLocalPtr<Stream> stream_;
+  // Copied for every thread that draws without setStream(), then long-jumped
+  // past its stream, away from the streams of setStream()
+  static Xoshiro256 next_stream_;
+  static bool next_stream_seeded_;
+  static std::mutex next_stream_mutex_;
 };
 
 } // namespace treadmill
@@ -0,0 +1,141 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include "treadmill/ReplayTrace.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <limits>
+
+#include <glog/logging.h>
+
+namespace facebook {
+namespace windtunnel {
+namespace treadmill {
+
+ReplayTrace::ReplayTrace(const std::string& filename) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  PCHECK(fd >= 0) << "Failed to open replay trace " << filename;
+  struct stat st;
+  PCHECK(fstat(fd, &st) == 0) << "Failed to stat replay trace " << filename;
+  mapping_size_ = st.st_size;
+  CHECK_GE(mapping_size_, sizeof(ReplayTraceHeader))
+      << filename << " is too short to be a replay trace";
+  mapping_ = mmap(nullptr, mapping_size_, PROT_READ, MAP_SHARED, fd, 0);
+  PCHECK(mapping_ != MAP_FAILED) << "Failed to map replay trace " << filename;
+  close(fd);
+  // Workers move through the trace front to back; read ahead aggressively
+  // and let the kernel drop pages behind them.
+  madvise(mapping_, mapping_size_, MADV_SEQUENTIAL);
+
+  header_ = static_cast<const ReplayTraceHeader*>(mapping_);
+  CHECK_EQ(header_->magic, ReplayTraceHeader::kMagic)
+      << filename << " is not a replay trace";
+  CHECK_EQ(header_->version, ReplayTraceHeader::kVersion)
+      << "Unsupported replay trace version in " << filename;
+  CHECK_EQ(header_->record_size, sizeof(ReplayRecord))
+      << "Unexpected record size in " << filename;
+  CHECK_EQ(
+      header_->keys_offset,
+      sizeof(ReplayTraceHeader) + header_->count * sizeof(ReplayRecord))
+      << filename << " is corrupt";
+  CHECK_GE(mapping_size_, header_->keys_offset + header_->keys_size)
+      << filename << " is truncated";
+  records_ = reinterpret_cast<const ReplayRecord*>(header_ + 1);
+  keys_ = static_cast<const char*>(mapping_) + header_->keys_offset;
+}
+
+ReplayTrace::~ReplayTrace() {
+  munmap(mapping_, mapping_size_);
+}
+
+ReplayTraceWriter::ReplayTraceWriter(const std::string& filename)
+    : filename_(filename),
+      keys_filename_(filename + ".keys.tmp"),
+      file_(fopen(filename.c_str(), "w")),
+      keys_file_(fopen(keys_filename_.c_str(), "w+")) {
+  PCHECK(file_ != nullptr) << "Failed to open " << filename;
+  PCHECK(keys_file_ != nullptr) << "Failed to open " << keys_filename_;
+  header_.magic = ReplayTraceHeader::kMagic;
+  header_.version = ReplayTraceHeader::kVersion;
+  header_.record_size = sizeof(ReplayRecord);
+  // Placeholder until finish()
+  PCHECK(fwrite(&header_, sizeof(header_), 1, file_) == 1)
+      << "Failed to write " << filename_;
+}
+
+ReplayTraceWriter::~ReplayTraceWriter() {
+  if (file_) {
+    fclose(file_);
+  }
+  if (keys_file_) {
+    fclose(keys_file_);
+    unlink(keys_filename_.c_str());
+  }
+}
+
+void ReplayTraceWriter::add(
+    int64_t timestamp_ns,
+    uint8_t operation,
+    folly::StringPiece key,
+    uint32_t value_size) {
+  CHECK(file_) << "Replay trace already finished";
+  CHECK_GE(timestamp_ns, last_timestamp_ns_)
+      << "Requests must be added in timestamp order";
+  CHECK_LE(key.size(), std::numeric_limits<uint16_t>::max())
+      << "Key too long: " << key;
+  last_timestamp_ns_ = timestamp_ns;
+
+  ReplayRecord record{};
+  record.timestamp_ns = timestamp_ns;
+  record.key_offset = header_.keys_size;
+  record.value_size = value_size;
+  record.key_length = key.size();
+  record.operation = operation;
+  PCHECK(fwrite(&record, sizeof(record), 1, file_) == 1)
+      << "Failed to write " << filename_;
+  PCHECK(fwrite(key.data(), 1, key.size(), keys_file_) == key.size())
+      << "Failed to write " << keys_filename_;
+
+  header_.count++;
+  header_.keys_size += key.size();
+  header_.max_value_size = std::max(header_.max_value_size, value_size);
+}
+
+void ReplayTraceWriter::finish() {
+  CHECK(file_) << "Replay trace already finished";
+  header_.keys_offset =
+      sizeof(ReplayTraceHeader) + header_.count * sizeof(ReplayRecord);
+
+  rewind(keys_file_);
+  char buffer[1 << 16];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), keys_file_)) > 0) {
+    PCHECK(fwrite(buffer, 1, n, file_) == n) << "Failed to write " << filename_;
+  }
+  PCHECK(!ferror(keys_file_)) << "Failed to read " << keys_filename_;
+
+  rewind(file_);
+  PCHECK(fwrite(&header_, sizeof(header_), 1, file_) == 1)
+      << "Failed to write " << filename_;
+  PCHECK(fclose(file_) == 0) << "Failed to write " << filename_;
+  file_ = nullptr;
+  fclose(keys_file_);
+  keys_file_ = nullptr;
+  unlink(keys_filename_.c_str());
+}
+
+} // namespace treadmill
+} // namespace windtunnel
+} // namespace facebook
@@ -0,0 +1,131 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include <folly/Range.h>
+
+namespace facebook {
+namespace windtunnel {
+namespace treadmill {
+
+/**
+ * One request of a trace to replay. The key lives in the key section of the
+ * file, at key_offset from its start.
+ */
+struct ReplayRecord {
+  // Since the first request of the trace
+  int64_t timestamp_ns;
+  uint64_t key_offset;
+  uint32_t value_size;
+  uint16_t key_length;
+  // Index into the workload's operation labels
+  uint8_t operation;
+  uint8_t reserved;
+};
+static_assert(sizeof(ReplayRecord) == 24, "ReplayRecord layout changed");
+
+/**
+ * Layout of the start of a replay trace file: the header, then count records
+ * sorted by timestamp, then keys_size bytes of keys.
+ */
+struct ReplayTraceHeader {
+  static constexpr uint64_t kMagic = 0x3159414c50455254; // "TREPLAY1"
+  static constexpr uint32_t kVersion = 1;
+
+  uint64_t magic;
+  uint32_t version;
+  uint32_t record_size;
+  uint64_t count;
+  uint64_t keys_offset;
+  uint64_t keys_size;
+  uint32_t max_value_size;
+  uint32_t reserved;
+};
+
+/**
+ * Read-only, memory-mapped view of a replay trace.
+ *
+ * Nothing is read up front: pages are faulted in as records are used and,
+ * being clean file pages, can be dropped again under memory pressure, so
+ * traces larger than RAM stream from disk. Any number of workers can share a
+ * trace without copying it.
+ */
+class ReplayTrace {
+ public:
+  explicit ReplayTrace(const std::string& filename);
+  ~ReplayTrace();
+
+  ReplayTrace(const ReplayTrace&) = delete;
+  ReplayTrace& operator=(const ReplayTrace&) = delete;
+
+  const ReplayTraceHeader& header() const {
+    return *header_;
+  }
+
+  uint64_t size() const {
+    return header_->count;
+  }
+
+  const ReplayRecord& operator[](uint64_t i) const {
+    return records_[i];
+  }
+
+  folly::StringPiece getKey(const ReplayRecord& record) const {
+    return folly::StringPiece(keys_ + record.key_offset, record.key_length);
+  }
+
+ private:
+  void* mapping_;
+  size_t mapping_size_;
+  const ReplayTraceHeader* header_;
+  const ReplayRecord* records_;
+  const char* keys_;
+};
+
+/**
+ * Writes a replay trace one request at a time. Keys go to a temporary file
+ * that is appended to the records when the trace is finished, so memory use
+ * doesn't grow with the trace.
+ */
+class ReplayTraceWriter {
+ public:
+  explicit ReplayTraceWriter(const std::string& filename);
+  ~ReplayTraceWriter();
+
+  ReplayTraceWriter(const ReplayTraceWriter&) = delete;
+  ReplayTraceWriter& operator=(const ReplayTraceWriter&) = delete;
+
+  // Requests must be added in timestamp order.
+  void add(
+      int64_t timestamp_ns,
+      uint8_t operation,
+      folly::StringPiece key,
+      uint32_t value_size);
+
+  // Writes the keys and the header; nothing may be added afterwards.
+  void finish();
+
+ private:
+  std::string filename_;
+  std::string keys_filename_;
+  FILE* file_;
+  FILE* keys_file_;
+  ReplayTraceHeader header_{};
+  int64_t last_timestamp_ns_{0};
+};
+
+} // namespace treadmill
+} // namespace windtunnel
+} // namespace facebook
@@ -10,11 +10,65 @@
 
 #pragma once
 
+#include <cstdint>
+
+#include <folly/Range.h>
+#include <folly/io/IOBuf.h>
+
 namespace facebook {
 namespace windtunnel {
 namespace treadmill {
 
-class Request {};
+class Request {
+ public:
+  virtual ~Request() = default;
+
+  /**
+   * Key the request operates on, if any. Captured for the slowest requests,
+   * so it must stay valid for the lifetime of the request.
+   */
+  virtual folly::StringPiece getKey() const {
+    return folly::StringPiece();
+  }
+
+  /**
+   * The key, held past the lifetime of the request, to be captured only if
+   * the request turns out to be one of the slowest. Copies it by default;
+   * requests whose keys are IOBufs already share them instead.
+   */
+  virtual folly::IOBuf shareKey() const {
+    auto key = getKey();
+    return key.empty() ? folly::IOBuf()
+                       : folly::IOBuf(folly::IOBuf::COPY_BUFFER, key);
+  }
+
+  /**
+   * Index of the request's operation in the labels returned by the workload's
+   * getOperationLabels(). The Worker uses it to pick pre-resolved
+   * per-operation statistics.
+   */
+  uint32_t getOperation() const {
+    return operation_;
+  }
+
+  // Size in bytes of the request's payload, for request traces
+  uint32_t getPayloadSize() const {
+    return payload_size_;
+  }
+
+ protected:
+  void setOperation(uint32_t operation) {
+    operation_ = operation;
+  }
+
+  void setPayloadSize(uint32_t payload_size) {
+    payload_size_ = payload_size;
+  }
+
+ private:
+  uint32_t operation_{0};
+  uint32_t payload_size_{0};
+};
 
 } // namespace treadmill
 } // namespace windtunnel
@@ -0,0 +1,109 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include "treadmill/RequestTrace.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <glog/logging.h>
+
+namespace facebook {
+namespace windtunnel {
+namespace treadmill {
+
+RequestTraceWriter::RequestTraceWriter(
+    const std::string& filename,
+    uint16_t worker,
+    uint64_t capacity,
+    uint32_t sample_rate)
+    : mapping_size_(sizeof(TraceFileHeader) + capacity * sizeof(TraceRecord)),
+      capacity_(capacity),
+      sample_rate_(sample_rate) {
+  CHECK_GT(capacity, 0) << "Trace capacity must be positive";
+  CHECK_GT(sample_rate, 0) << "Trace sample rate must be positive";
+
+  int fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  PCHECK(fd >= 0) << "Failed to open trace file " << filename;
+  PCHECK(ftruncate(fd, mapping_size_) == 0)
+      << "Failed to size trace file " << filename;
+  mapping_ =
+      mmap(nullptr, mapping_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  PCHECK(mapping_ != MAP_FAILED) << "Failed to map trace file " << filename;
+  close(fd);
+
+  header_ = static_cast<TraceFileHeader*>(mapping_);
+  header_->magic = TraceFileHeader::kMagic;
+  header_->version = TraceFileHeader::kVersion;
+  header_->record_size = sizeof(TraceRecord);
+  header_->capacity = capacity;
+  header_->records_written = 0;
+  header_->sample_rate = sample_rate;
+  header_->worker = worker;
+  records_ = reinterpret_cast<TraceRecord*>(header_ + 1);
+
+  // Start with the first request, so that even short runs get traced.
+  since_last_sample_ = sample_rate - 1;
+}
+
+RequestTraceWriter::~RequestTraceWriter() {
+  munmap(mapping_, mapping_size_);
+}
+
+RequestTraceReader::RequestTraceReader(const std::string& filename) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  PCHECK(fd >= 0) << "Failed to open trace file " << filename;
+  struct stat st;
+  PCHECK(fstat(fd, &st) == 0) << "Failed to stat trace file " << filename;
+  mapping_size_ = st.st_size;
+  CHECK_GE(mapping_size_, sizeof(TraceFileHeader))
+      << filename << " is too short to be a trace file";
+  mapping_ = mmap(nullptr, mapping_size_, PROT_READ, MAP_SHARED, fd, 0);
+  PCHECK(mapping_ != MAP_FAILED) << "Failed to map trace file " << filename;
+  close(fd);
+
+  header_ = static_cast<const TraceFileHeader*>(mapping_);
+  CHECK_EQ(header_->magic, TraceFileHeader::kMagic)
+      << filename << " is not a trace file";
+  CHECK_EQ(header_->version, TraceFileHeader::kVersion)
+      << "Unsupported trace file version in " << filename;
+  CHECK_EQ(header_->record_size, sizeof(TraceRecord))
+      << "Unexpected record size in " << filename;
+  CHECK_GE(
+      mapping_size_,
+      sizeof(TraceFileHeader) + header_->capacity * sizeof(TraceRecord))
+      << filename << " is truncated";
+  records_ = reinterpret_cast<const TraceRecord*>(header_ + 1);
+}
+
+RequestTraceReader::~RequestTraceReader() {
+  munmap(mapping_, mapping_size_);
+}
+
+uint64_t RequestTraceReader::size() const {
+  return std::min(header_->records_written, header_->capacity);
+}
+
+const TraceRecord& RequestTraceReader::operator[](uint64_t i) const {
+  DCHECK_LT(i, size());
+  if (header_->records_written <= header_->capacity) {
+    return records_[i];
+  }
+  // The ring wrapped; the oldest record is the next one to be overwritten.
+  return records_[(header_->records_written + i) % header_->capacity];
+}
+
+} // namespace treadmill
+} // namespace windtunnel
+} // namespace facebook
@@ -0,0 +1,140 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace facebook {
+namespace windtunnel {
+namespace treadmill {
+
+enum class TraceStatus : uint8_t {
+  OK = 0,
+  ERROR = 1,
+  // The worker was at its outstanding request limit; never sent.
+  DROPPED = 2,
+};
+
+/**
+ * Lifecycle of one request. Times are CLOCK_MONOTONIC nanoseconds (see
+ * nowNs()); the send and receive times of a dropped request are 0.
+ */
+struct TraceRecord {
+  // When the scheduler asked for the request to be sent
+  int64_t intended_time_ns;
+  int64_t send_time_ns;
+  int64_t receive_time_ns;
+  uint32_t connection;
+  uint32_t payload_size;
+  uint16_t worker;
+  uint16_t operation;
+  TraceStatus status;
+  uint8_t reserved[3];
+};
+static_assert(sizeof(TraceRecord) == 40, "TraceRecord layout changed");
+
+/**
+ * Layout of the start of a trace file; the records follow right after it.
+ * The records form a ring: once records_written exceeds capacity the oldest
+ * record is at index records_written % capacity.
+ */
+struct TraceFileHeader {
+  static constexpr uint64_t kMagic = 0x3143525444415254; // "TRADTRC1"
+  static constexpr uint32_t kVersion = 1;
+
+  uint64_t magic;
+  uint32_t version;
+  uint32_t record_size;
+  uint64_t capacity;
+  uint64_t records_written;
+  uint32_t sample_rate;
+  uint32_t worker;
+};
+
+/**
+ * Writes TraceRecords of one worker to a memory-mapped ring file.
+ *
+ * The file is sized and mapped up front, so recording is a copy into the
+ * mapping and a couple of stores: no allocation, no locks and no system calls.
+ * The kernel writes the pages back in the background. Only one thread may use
+ * a writer.
+ */
+class RequestTraceWriter {
+ public:
+  RequestTraceWriter(
+      const std::string& filename,
+      uint16_t worker,
+      uint64_t capacity,
+      uint32_t sample_rate);
+  ~RequestTraceWriter();
+
+  RequestTraceWriter(const RequestTraceWriter&) = delete;
+  RequestTraceWriter& operator=(const RequestTraceWriter&) = delete;
+
+  /**
+   * Whether the next request should be traced; true for one request in every
+   * sample_rate.
+   */
+  bool shouldSample() {
+    if (++since_last_sample_ < sample_rate_) {
+      return false;
+    }
+    since_last_sample_ = 0;
+    return true;
+  }
+
+  void record(const TraceRecord& record) {
+    records_[header_->records_written % capacity_] = record;
+    header_->records_written++;
+  }
+
+ private:
+  void* mapping_;
+  size_t mapping_size_;
+  TraceFileHeader* header_;
+  TraceRecord* records_;
+  uint64_t capacity_;
+  uint32_t sample_rate_;
+  uint32_t since_last_sample_{0};
+};
+
+/**
+ * Read-only view of a trace file written by RequestTraceWriter.
+ */
+class RequestTraceReader {
+ public:
+  explicit RequestTraceReader(const std::string& filename);
+  ~RequestTraceReader();
+
+  RequestTraceReader(const RequestTraceReader&) = delete;
+  RequestTraceReader& operator=(const RequestTraceReader&) = delete;
+
+  const TraceFileHeader& header() const {
+    return *header_;
+  }
+
+  // Number of records still in the ring
+  uint64_t size() const;
+
+  // The i-th oldest record still in the ring
+  const TraceRecord& operator[](uint64_t i) const;
+
+ private:
+  void* mapping_;
+  size_t mapping_size_;
+  const TraceFileHeader* header_;
+  const TraceRecord* records_;
+};
+
+} // namespace treadmill
+} // namespace windtunnel
+} // namespace facebook
@@ -14,6 +14,7 @@
 #include <folly/futures/Future.h>
 #include <folly/futures/Promise.h>
 
+#include "treadmill/RandomEngine.h"
 #include "treadmill/Util.h"
 
 DEFINE_bool(
@@ -122,10 +123,32 @@ void Scheduler::setRps(int32_t rps) {
 }
 
 double Scheduler::randomExponentialInterval(double mean) {
-  static std::mt19937* rng = new std::mt19937();
-  std::uniform_real_distribution<double> dist(0, 1.0);
-  /* Cap the lower end so that we don't return infinity */
-  return -log(std::max(dist(*rng), 1e-9)) * mean;
+  return ThreadSafeRandomEngine::getExponential(mean);
+}
+
+void Scheduler::setReplayTrace(
+    std::shared_ptr<const ReplayTrace> trace,
+    double speed) {
+  CHECK(!thread_) << "The replay trace must be set before run()";
+  CHECK_GT(speed, 0);
+  replay_trace_ = std::move(trace);
+  replay_speed_ = speed;
+}
+
+bool Scheduler::nextInterval(uint64_t i, int64_t mean_ns, int64_t* interval_ns)
+    const {
+  if (!replay_trace_) {
+    *interval_ns = randomExponentialInterval(mean_ns);
+    return true;
+  }
+  if (i >= replay_trace_->size()) {
+    return false;
+  }
+  const auto& trace = *replay_trace_;
+  *interval_ns = i == 0
+      ? 0
+      : (trace[i].timestamp_ns - trace[i - 1].timestamp_ns) / replay_speed_;
+  return true;
 }
 
 void Scheduler::waitNs(int64_t ns) {
@@ -149,17 +172,30 @@ void Scheduler::messageAllWorkers(Event event) {
 /**
  * Responsible for generating requests events.
  * Requests are randomly spaced (intervals are drawn from an
- * exponential distribution) to achieve the target throughput rate.
+ * exponential distribution) to achieve the target throughput rate, or spaced
+ * as in the replay trace.
  * Events would be put into notification queues, which would be selected in
  * round-robin fashion.
  */
 void Scheduler::loop() {
   do {
     messageAllWorkers(Event(EventType::RESET));
+    // Arrivals start over along with the workloads, from the same stream in
+    // every run with the same seed.
+    ThreadSafeRandomEngine::setStream(0);
     next_ = 0;
     int32_t rps = rps_;
     int64_t interval_ns = 1.0 / rps * k_ns_per_s;
-    int64_t a = 0, b = 0, budget = randomExponentialInterval(interval_ns);
+    uint64_t sent = 0;
+    int64_t a = 0, b = 0, budget = 0, next_interval = 0;
+    if (!nextInterval(sent, interval_ns, &budget)) {
+      LOG(INFO) << "Replay trace is empty";
+      state_.store(STOPPING);
+    }
+    // When the next arrival is due: the start plus every interval drawn so
+    // far, however late the loop runs, so that queue waits and traces show
+    // the whole delay.
+    int64_t intended_ns = nowNs() + budget;
     while (state_ == RUNNING) {
       b = nowNs();
       if (a) {
@@ -170,8 +206,12 @@ void Scheduler::loop() {
       a = nowNs();
       /* Decrease the sleep budget by the exact time slept (could have been
          more than the budget value), increase by the next interval */
-      budget += randomExponentialInterval(interval_ns) - (a - b);
-      queues_[next_].putMessage(Event(EventType::SEND_REQUEST));
+      bool more = nextInterval(++sent, interval_ns, &next_interval);
+      budget += next_interval - (a - b);
+      Event event(EventType::SEND_REQUEST);
+      event.setTimestampNs(intended_ns);
+      intended_ns += next_interval;
+      queues_[next_].putMessage(std::move(event));
       if (queues_[next_].size() > logging_threshold_ * logged_[next_]) {
         LOG(INFO) << "Notification queue for worker " << next_
                   << " is overloaded by factor of " << logged_[next_];
@@ -185,6 +225,10 @@ void Scheduler::loop() {
         rps = rps_;
         interval_ns = 1.0 / rps * k_ns_per_s;
       }
+      if (!more) {
+        LOG(INFO) << "Replayed all " << sent << " requests of the trace";
+        state_.store(STOPPING);
+      }
     }
     while (state_ == PAUSED)
       waitNs(1000);
@@ -18,6 +18,7 @@
 #include <folly/io/async/NotificationQueue.h>
 
 #include "treadmill/Event.h"
+#include "treadmill/ReplayTrace.h"
 
 DECLARE_bool(wait_for_runner_ready);
 
@@ -70,6 +71,15 @@ class Scheduler {
 
   void setRps(int32_t rps);
 
+  /**
+   * Send requests at the times of the requests in trace instead of at random
+   * intervals, speed times faster than they were recorded. Request i of the
+   * trace goes to worker i % number_of_workers, so a workload replaying the
+   * records of its own worker with that stride sends each at its time. The
+   * scheduler stops at the end of the trace. Must be called before run().
+   */
+  void setReplayTrace(std::shared_ptr<const ReplayTrace> trace, double speed);
+
  private:
   enum RunState { RUNNING, PAUSED, STOPPING };
 
@@ -78,6 +88,13 @@ class Scheduler {
    */
   static double randomExponentialInterval(double mean);
 
+  /**
+   * Time from request i - 1 to request i of the replay trace, or a random
+   * interval with the given mean if there is none. Returns false at the end
+   * of the trace.
+   */
+  bool nextInterval(uint64_t i, int64_t mean_ns, int64_t* interval_ns) const;
+
   /**
    * Waits until given amount of nanosecond pases, for precise timing it uses
    * spin-loop.
@@ -99,6 +116,8 @@ class Scheduler {
   std::vector<uint64_t> logged_;
   std::vector<folly::NotificationQueue<Event>> queues_;
   std::atomic<RunState> state_;
+  std::shared_ptr<const ReplayTrace> replay_trace_;
+  double replay_speed_{1};
   std::unique_ptr<std::thread> thread_;
   folly::Promise<folly::Unit> promise_;
 };
@@ -0,0 +1,171 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include "treadmill/SizeDistribution.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glog/logging.h>
+
+namespace facebook {
+namespace windtunnel {
+namespace treadmill {
+
+/* static */ std::unique_ptr<SizeDistribution> SizeDistribution::make(
+    const folly::dynamic& config,
+    uint64_t seed) {
+  auto type = config.getDefault("type", "fixed").asString();
+  if (type == "fixed") {
+    return std::make_unique<FixedSizeDistribution>(
+        seed, config.getDefault("size", 8).asInt());
+  } else if (type == "uniform") {
+    return std::make_unique<UniformSizeDistribution>(
+        seed, config["min"].asInt(), config["max"].asInt());
+  } else if (type == "empirical") {
+    std::vector<size_t> sizes;
+    for (const auto& size : config["sizes"]) {
+      sizes.push_back(size.asInt());
+    }
+    std::vector<double> weights;
+    for (const auto& weight : config["weights"]) {
+      weights.push_back(weight.asDouble());
+    }
+    return std::make_unique<EmpiricalSizeDistribution>(
+        seed, std::move(sizes), weights);
+  } else if (type == "gev") {
+    return std::make_unique<GevSizeDistribution>(
+        seed,
+        config.getDefault("location", 30.7984).asDouble(),
+        config.getDefault("scale", 8.20449).asDouble(),
+        config.getDefault("shape", 0.078688).asDouble(),
+        config.getDefault("min", 1).asInt(),
+        config.getDefault("max", 1 << 20).asInt());
+  } else if (type == "pareto") {
+    return std::make_unique<GeneralizedParetoSizeDistribution>(
+        seed,
+        config.getDefault("location", 0.0).asDouble(),
+        config.getDefault("scale", 214.476).asDouble(),
+        config.getDefault("shape", 0.348238).asDouble(),
+        config.getDefault("min", 1).asInt(),
+        config.getDefault("max", 1 << 20).asInt());
+  }
+  LOG(FATAL) << "Unknown size distribution: " << type;
+  return nullptr;
+}
+
+FixedSizeDistribution::FixedSizeDistribution(uint64_t seed, size_t size)
+    : SizeDistribution(seed), size_(size) {}
+
+size_t FixedSizeDistribution::next() {
+  return size_;
+}
+
+size_t FixedSizeDistribution::getMaxSize() const {
+  return size_;
+}
+
+UniformSizeDistribution::UniformSizeDistribution(
+    uint64_t seed,
+    size_t min,
+    size_t max)
+    : SizeDistribution(seed), min_(min), max_(max) {
+  CHECK_LE(min, max);
+}
+
+size_t UniformSizeDistribution::next() {
+  return min_ +
+      size_t((unsigned __int128)engine_() * (max_ - min_ + 1) >> 64);
+}
+
+size_t UniformSizeDistribution::getMaxSize() const {
+  return max_;
+}
+
+EmpiricalSizeDistribution::EmpiricalSizeDistribution(
+    uint64_t seed,
+    std::vector<size_t> sizes,
+    const std::vector<double>& weights)
+    : SizeDistribution(seed), sizes_(std::move(sizes)), table_(weights) {
+  CHECK_EQ(sizes_.size(), weights.size());
+}
+
+size_t EmpiricalSizeDistribution::next() {
+  return sizes_[table_(engine_)];
+}
+
+size_t EmpiricalSizeDistribution::getMaxSize() const {
+  return *std::max_element(sizes_.begin(), sizes_.end());
+}
+
+GevSizeDistribution::GevSizeDistribution(
+    uint64_t seed,
+    double location,
+    double scale,
+    double shape,
+    size_t min,
+    size_t max)
+    : SizeDistribution(seed),
+      location_(location),
+      scale_(scale),
+      shape_(shape),
+      min_(min),
+      max_(max) {
+  CHECK_GT(scale, 0);
+  CHECK_LE(min, max);
+}
+
+size_t GevSizeDistribution::next() {
+  // Inverse of the CDF exp(-(1 + shape * (x - location) / scale)^(-1/shape))
+  double t = -std::log(nextDouble());
+  double x = shape_ == 0
+      ? location_ - scale_ * std::log(t)
+      : location_ + scale_ * std::expm1(-shape_ * std::log(t)) / shape_;
+  return std::clamp<double>(std::round(x), min_, max_);
+}
+
+size_t GevSizeDistribution::getMaxSize() const {
+  return max_;
+}
+
+GeneralizedParetoSizeDistribution::GeneralizedParetoSizeDistribution(
+    uint64_t seed,
+    double location,
+    double scale,
+    double shape,
+    size_t min,
+    size_t max)
+    : SizeDistribution(seed),
+      location_(location),
+      scale_(scale),
+      shape_(shape),
+      min_(min),
+      max_(max) {
+  CHECK_GT(scale, 0);
+  CHECK_LE(min, max);
+}
+
+size_t GeneralizedParetoSizeDistribution::next() {
+  // Inverse of the CDF 1 - (1 + shape * (x - location) / scale)^(-1/shape),
+  // with u standing in for 1 - CDF
+  double log_u = std::log(nextDouble());
+  double x = shape_ == 0
+      ? location_ - scale_ * log_u
+      : location_ + scale_ * std::expm1(-shape_ * log_u) / shape_;
+  return std::clamp<double>(std::round(x), min_, max_);
+}
+
+size_t GeneralizedParetoSizeDistribution::getMaxSize() const {
+  return max_;
+}
+
+} // namespace treadmill
+} // namespace windtunnel
+} // namespace facebook
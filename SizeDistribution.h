@@ -0,0 +1,162 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <folly/dynamic.h>
+
+#include "treadmill/AliasTable.h"
+#include "treadmill/Xoshiro256.h"
+
+namespace facebook {
+namespace windtunnel {
+namespace treadmill {
+
+/**
+ * Distribution of the sizes, in bytes, of the values a workload writes. Like
+ * KeyChooser, every worker has its own instance, which isn't thread-safe.
+ */
+class SizeDistribution {
+ public:
+  virtual ~SizeDistribution() = default;
+
+  /**
+   * Make a distribution from the workload config, e.g.
+   *   {"type": "uniform", "min": 100, "max": 1000}
+   * Types and their parameters:
+   *   fixed      size (default 8)
+   *   uniform    min, max
+   *   empirical  sizes and their weights, two arrays of the same length
+   *   gev        generalized extreme value with location, scale and shape
+   *   pareto     generalized Pareto with location, scale and shape
+   * both clamped to [min, max]. Their defaults are the fits for the Facebook
+   * ETC pool in "Workload Analysis of a Large-Scale Key-Value Store"
+   * (Atikoglu et al., SIGMETRICS 2012): gev for key sizes, pareto for value
+   * sizes.
+   */
+  static std::unique_ptr<SizeDistribution> make(
+      const folly::dynamic& config,
+      uint64_t seed);
+
+  virtual size_t next() = 0;
+
+  // No size drawn is larger.
+  virtual size_t getMaxSize() const = 0;
+
+  // Start over with the sequence of sizes drawn since construction.
+  void reset() {
+    engine_.seed(seed_);
+  }
+
+  // Start over with another seed.
+  void seed(uint64_t seed) {
+    seed_ = seed;
+    reset();
+  }
+
+ protected:
+  explicit SizeDistribution(uint64_t seed) : seed_(seed), engine_(seed) {}
+
+  // Uniform in (0, 1)
+  double nextDouble() {
+    return Xoshiro256::toUniform(engine_());
+  }
+
+  uint64_t seed_;
+  Xoshiro256 engine_;
+};
+
+class FixedSizeDistribution : public SizeDistribution {
+ public:
+  FixedSizeDistribution(uint64_t seed, size_t size);
+
+  size_t next() override;
+  size_t getMaxSize() const override;
+
+ private:
+  const size_t size_;
+};
+
+class UniformSizeDistribution : public SizeDistribution {
+ public:
+  UniformSizeDistribution(uint64_t seed, size_t min, size_t max);
+
+  size_t next() override;
+  size_t getMaxSize() const override;
+
+ private:
+  const size_t min_;
+  const size_t max_;
+};
+
+class EmpiricalSizeDistribution : public SizeDistribution {
+ public:
+  EmpiricalSizeDistribution(
+      uint64_t seed,
+      std::vector<size_t> sizes,
+      const std::vector<double>& weights);
+
+  size_t next() override;
+  size_t getMaxSize() const override;
+
+ private:
+  const std::vector<size_t> sizes_;
+  const AliasTable table_;
+};
+
+class GevSizeDistribution : public SizeDistribution {
+ public:
+  GevSizeDistribution(
+      uint64_t seed,
+      double location,
+      double scale,
+      double shape,
+      size_t min,
+      size_t max);
+
+  size_t next() override;
+  size_t getMaxSize() const override;
+
+ private:
+  const double location_;
+  const double scale_;
+  const double shape_;
+  const size_t min_;
+  const size_t max_;
+};
+
+class GeneralizedParetoSizeDistribution : public SizeDistribution {
+ public:
+  GeneralizedParetoSizeDistribution(
+      uint64_t seed,
+      double location,
+      double scale,
+      double shape,
+      size_t min,
+      size_t max);
+
+  size_t next() override;
+  size_t getMaxSize() const override;
+
+ private:
+  const double location_;
+  const double scale_;
+  const double shape_;
+  const size_t min_;
+  const size_t max_;
+};
+
+} // namespace treadmill
+} // namespace windtunnel
+} // namespace facebook
@@ -0,0 +1,81 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include "treadmill/SlowRequests.h"
+
+#include <algorithm>
+
+namespace facebook {
+namespace windtunnel {
+namespace treadmill {
+
+namespace {
+
+bool slower(const SlowRequest& a, const SlowRequest& b) {
+  return a.latency > b.latency;
+}
+
+} // namespace
+
+folly::dynamic SlowRequest::toDynamic(
+    const std::vector<std::string>& labels) const {
+  return folly::dynamic::object("latency", latency)(
+      "send_time_ns", send_time_ns)("key", key.get().str())("worker", worker)(
+      "connection", connection)(
+      "operation",
+      operation < labels.size() ? folly::dynamic(labels[operation])
+                                : folly::dynamic(operation))("error", error);
+}
+
+SlowRequestReservoir::SlowRequestReservoir(size_t capacity)
+    : capacity_(capacity), threshold_(emptyThreshold()) {
+  heap_.reserve(capacity);
+}
+
+void SlowRequestReservoir::add(const SlowRequest& request) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (heap_.size() < capacity_) {
+    heap_.push_back(request);
+    std::push_heap(heap_.begin(), heap_.end(), slower);
+  } else if (request.latency > heap_.front().latency) {
+    std::pop_heap(heap_.begin(), heap_.end(), slower);
+    heap_.back() = request;
+    std::push_heap(heap_.begin(), heap_.end(), slower);
+  }
+  if (heap_.size() == capacity_) {
+    threshold_.store(heap_.front().latency, std::memory_order_relaxed);
+  }
+}
+
+std::vector<SlowRequest> SlowRequestReservoir::drain() {
+  std::vector<SlowRequest> requests;
+  requests.reserve(capacity_);
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    heap_.swap(requests);
+    threshold_.store(emptyThreshold(), std::memory_order_relaxed);
+  }
+  std::sort(requests.begin(), requests.end(), slower);
+  return requests;
+}
+
+void mergeSlowRequests(
+    std::vector<SlowRequest>& slowest,
+    const std::vector<SlowRequest>& requests,
+    size_t n) {
+  slowest.insert(slowest.end(), requests.begin(), requests.end());
+  auto middle = slowest.begin() + std::min(n, slowest.size());
+  std::partial_sort(slowest.begin(), middle, slowest.end(), slower);
+  slowest.erase(middle, slowest.end());
+}
+
+} // namespace treadmill
+} // namespace windtunnel
+} // namespace facebook
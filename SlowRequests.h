@@ -0,0 +1,109 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <folly/Range.h>
+#include <folly/dynamic.h>
+
+namespace facebook {
+namespace windtunnel {
+namespace treadmill {
+
+/**
+ * Key of a request, truncated to a fixed size so that capturing it never
+ * allocates.
+ */
+class SlowRequestKey {
+ public:
+  static constexpr size_t kMaxLength = 64;
+
+  SlowRequestKey() = default;
+  explicit SlowRequestKey(folly::StringPiece key)
+      : length_(std::min(key.size(), kMaxLength)) {
+    std::copy(key.begin(), key.begin() + length_, data_.begin());
+  }
+
+  folly::StringPiece get() const {
+    return folly::StringPiece(data_.data(), length_);
+  }
+
+ private:
+  size_t length_{0};
+  std::array<char, kMaxLength> data_;
+};
+
+struct SlowRequest {
+  double latency;
+  int64_t send_time_ns;
+  SlowRequestKey key;
+  uint32_t worker;
+  uint32_t connection;
+  // Index into the workload's operation labels
+  uint32_t operation;
+  bool error;
+
+  folly::dynamic toDynamic(const std::vector<std::string>& labels) const;
+};
+
+/**
+ * The slowest requests of one worker in the current interval.
+ *
+ * Once the reservoir is full, a request only gets in if it is slower than the
+ * fastest one kept, so the worker checks admits() before building a
+ * SlowRequest: one comparison against a threshold for almost every request.
+ * Only admitted requests take the lock, which the reporter shares once per
+ * interval to drain the reservoir.
+ */
+class SlowRequestReservoir {
+ public:
+  explicit SlowRequestReservoir(size_t capacity);
+
+  bool admits(double latency) const {
+    return latency > threshold_.load(std::memory_order_relaxed);
+  }
+
+  void add(const SlowRequest& request);
+
+  // The requests kept so far, slowest first, leaving the reservoir empty.
+  std::vector<SlowRequest> drain();
+
+ private:
+  double emptyThreshold() const {
+    return capacity_ == 0 ? std::numeric_limits<double>::infinity() : -1.0;
+  }
+
+  const size_t capacity_;
+  std::atomic<double> threshold_;
+  std::mutex mutex_;
+  // Min-heap on latency
+  std::vector<SlowRequest> heap_;
+};
+
+/**
+ * Keep the n slowest of slowest and requests in slowest, slowest first.
+ */
+void mergeSlowRequests(
+    std::vector<SlowRequest>& slowest,
+    const std::vector<SlowRequest>& requests,
+    size_t n);
+
+} // namespace treadmill
+} // namespace windtunnel
+} // namespace facebook
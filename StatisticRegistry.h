@@ -0,0 +1,86 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include <folly/AtomicUnorderedMap.h>
+
+namespace facebook {
+namespace windtunnel {
+namespace treadmill {
+
+/**
+ * Name to statistic map that is read far more often than it is written.
+ *
+ * Statistics are inserted once and never removed, so lookups of an existing
+ * name are lock-free and wait-free. Inserting a new name is lock-free as well;
+ * if two threads race to create the same statistic, one of the two instances
+ * is dropped and both get the winner.
+ *
+ * get() hands out raw pointers as handles. They stay valid for the lifetime of
+ * the registry, and using them does not touch any shared reference count,
+ * which makes them cheap to resolve or pass around per request.
+ */
+template <class T>
+class StatisticRegistry {
+ public:
+  explicit StatisticRegistry(size_t max_size) : map_(max_size) {}
+
+  /**
+   * Find the statistic called name, creating it with factory() if needed.
+   */
+  template <class Factory>
+  T* get(const std::string& name, Factory&& factory) {
+    auto it = map_.find(name);
+    if (it != map_.cend()) {
+      return it->second.get();
+    }
+    return map_
+        .findOrConstruct(
+            name,
+            [&](void* raw) { new (raw) std::shared_ptr<T>(factory()); })
+        .first->second.get();
+  }
+
+  /**
+   * Same as get(), sharing ownership with the registry.
+   */
+  template <class Factory>
+  std::shared_ptr<T> getShared(const std::string& name, Factory&& factory) {
+    get(name, std::forward<Factory>(factory));
+    return map_.find(name)->second;
+  }
+
+  /**
+   * Call fn(name, statistic) for every statistic, ordered by name. Statistics
+   * created concurrently may or may not be visited.
+   */
+  template <class Fn>
+  void forEach(Fn&& fn) const {
+    std::map<std::string, T*> sorted;
+    for (auto it = map_.cbegin(); it != map_.cend(); ++it) {
+      sorted.emplace(it->first, it->second.get());
+    }
+    for (auto& entry : sorted) {
+      fn(entry.first, *entry.second);
+    }
+  }
+
+ private:
+  folly::AtomicUnorderedInsertMap<std::string, std::shared_ptr<T>> map_;
+};
+
+} // namespace treadmill
+} // namespace windtunnel
+} // namespace facebook
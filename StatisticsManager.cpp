@@ -10,6 +10,9 @@
 
 #include "treadmill/StatisticsManager.h"
 
+#include <algorithm>
+#include <cmath>
+
 #include <glog/logging.h>
 
 #include <folly/Format.h>
@@ -17,6 +20,34 @@
 #include <folly/Singleton.h>
 #include <folly/dynamic.h>
 #include <folly/json.h>
+#include <gflags/gflags.h>
+
+DEFINE_int32(
+    histogram_significant_bits,
+    facebook::windtunnel::treadmill::Histogram::kDefaultSignificantBits,
+    "Significant bits kept by latency histograms. Reported values are within "
+    "a relative error of 2^-(bits - 1).");
+
+DEFINE_int32(
+    max_statistics,
+    16 * 1024,
+    "Maximum number of distinct histograms and of distinct counters.");
+
+DEFINE_int32(
+    live_stats_max_intervals,
+    300,
+    "Number of most recent intervals kept for live statistics queries.");
+
+DEFINE_int32(
+    slow_requests_per_interval,
+    10,
+    "Number of slowest requests captured per worker and interval, with their "
+    "key, operation and connection. 0 disables the capture.");
+
+DEFINE_int32(
+    slow_requests_in_results,
+    100,
+    "Number of slowest requests of the whole run kept for the results.");
 
 namespace facebook {
 namespace windtunnel {
@@ -26,85 +57,238 @@ namespace {
 struct PrivateTag {};
 
 static folly::Singleton<StatisticsManager, PrivateTag> managerSingle;
-const auto kQuantiles = std::array<double, 13>{
-    {0.01,
-     0.05,
-     0.10,
-     0.15,
-     0.20,
-     0.50,
-     0.80,
-     0.85,
-     0.90,
-     0.95,
-     0.99,
-     0.999,
-     1.0}};
+const std::vector<double> kQuantiles = {0.01,
+                                        0.05,
+                                        0.10,
+                                        0.15,
+                                        0.20,
+                                        0.50,
+                                        0.80,
+                                        0.85,
+                                        0.90,
+                                        0.95,
+                                        0.99,
+                                        0.999,
+                                        1.0};
+
+// Quantiles exported as fb303 counters
+const std::vector<double> kCounterQuantiles = {0.5, 0.9, 0.99, 0.999};
+
+std::shared_ptr<StatisticsManager::Histogram> makeHistogram() {
+  return std::make_shared<StatisticsManager::Histogram>(
+      FLAGS_histogram_significant_bits);
+}
+
+void printHistogram(const std::string& name, const Histogram& histogram) {
+  // Unlike the counter there's no printStatistic for our histograms. So we
+  // have to do that here.
+  LOG(INFO) << name;
+  auto values = histogram.getQuantiles(kQuantiles);
+
+  LOG(INFO) << "Count: " << histogram.getCount();
+  LOG(INFO) << "Avg: " << histogram.getMean();
+  for (size_t i = 0; i < kQuantiles.size(); ++i) {
+    LOG(INFO) << folly::sformat(
+        "P{:g}: {:.2f}", kQuantiles[i] * 100, values[i]);
+  }
+}
+
+void addHistogramCounters(
+    std::map<std::string, int64_t>& counters,
+    const std::string& prefix,
+    const Histogram& histogram) {
+  counters[prefix + ".count"] = histogram.getCount();
+  counters[prefix + ".avg"] = std::llround(histogram.getMean());
+  auto values = histogram.getQuantiles(kCounterQuantiles);
+  for (size_t i = 0; i < kCounterQuantiles.size(); ++i) {
+    counters[folly::sformat("{}.p{:g}", prefix, kCounterQuantiles[i] * 100)] =
+        std::llround(values[i]);
+  }
+}
+
+// Sum the count and the subkeys of a counter's toDynamic() into total.
+void mergeCounterDynamic(folly::dynamic& total, const folly::dynamic& counter) {
+  if (total.count("count") == 0) {
+    total = counter;
+    return;
+  }
+  total["count"] = total["count"].asInt() + counter["count"].asInt();
+  for (const auto& subkey : counter["subkeys"].items()) {
+    auto& sum = total["subkeys"].setDefault(subkey.first, 0);
+    sum = sum.asInt() + subkey.second.asInt();
+  }
+}
 
 } // namespace
 /* static */ std::shared_ptr<StatisticsManager> StatisticsManager::get() {
   return managerSingle.try_get();
 }
 
+StatisticsManager::StatisticsManager()
+    : histo_map_(FLAGS_max_statistics),
+      count_map_(FLAGS_max_statistics),
+      phase_names_(std::vector<std::string>{DEFAULT_PHASE}),
+      live_statistics_(
+          FLAGS_live_stats_max_intervals,
+          FLAGS_histogram_significant_bits,
+          FLAGS_slow_requests_in_results) {}
+
 void StatisticsManager::print() const {
-  LOG(INFO) << "Statistics:";
-  LOG(INFO) << "";
-  count_map_.withWLock([](auto& m) {
-    for (auto& cp : m) {
-      LOG(INFO) << cp.first;
-      cp.second->printStatistic();
+  auto phases = getPhaseNames();
+  for (size_t phase = 0; phase < phases.size(); ++phase) {
+    if (phases.size() == 1) {
+      LOG(INFO) << "Statistics:";
+    } else {
+      LOG(INFO) << "Statistics for phase " << phases[phase] << ":";
     }
-  });
+    LOG(INFO) << "";
+    count_map_.forEach([&](const std::string& name, const Counter& counter) {
+      if (auto c = counter.getPhase(phase)) {
+        LOG(INFO) << name;
+        c->printStatistic();
+      }
+    });
+
+    histo_map_.forEach(
+        [&](const std::string& name, const Histogram& histogram) {
+          if (auto h = histogram.getPhase(phase)) {
+            printHistogram(name, *h);
+          }
+        });
+  }
 
-  histo_map_.withWLock([](auto& m) {
-    for (auto& cp : m) {
-      // Unlike the counter there's no printStatistic for our histograms. So we
-      // have to do that here.
-      LOG(INFO) << cp.first;
-      cp.second->flush();
-      auto est = cp.second->estimateQuantiles(kQuantiles);
-
-      LOG(INFO) << "Count: " << folly::sformat("{:.0f}", est.count);
-      LOG(INFO) << "Avg: " << est.sum / std::max(1.0, est.count);
-      for (const auto& q : est.quantiles) {
-        LOG(INFO) << folly::sformat("P{:.0f}: {:.2f}", q.first * 100, q.second);
+  if (phases.size() > 1) {
+    LOG(INFO) << "Statistics for all phases:";
+    LOG(INFO) << "";
+    count_map_.forEach([](const std::string& name, const Counter& counter) {
+      LOG(INFO) << name;
+      LOG(INFO) << "Count: " << counter.getCount();
+    });
+    histo_map_.forEach(
+        [](const std::string& name, const Histogram& histogram) {
+          printHistogram(name, histogram.merged());
+        });
+  }
+}
+
+folly::dynamic StatisticsManager::toDynamic() const {
+  auto phase_names = getPhaseNames();
+  folly::dynamic phases = folly::dynamic::object;
+  folly::dynamic counters = folly::dynamic::object;
+  folly::dynamic histograms = folly::dynamic::object;
+  for (size_t phase = 0; phase < phase_names.size(); ++phase) {
+    folly::dynamic phase_counters = folly::dynamic::object;
+    count_map_.forEach([&](const std::string& name, const Counter& counter) {
+      if (auto c = counter.getPhase(phase)) {
+        phase_counters[name] = c->toDynamic();
+        mergeCounterDynamic(counters.setDefault(name), phase_counters[name]);
       }
+    });
+
+    folly::dynamic phase_histograms = folly::dynamic::object;
+    histo_map_.forEach(
+        [&](const std::string& name, const Histogram& histogram) {
+          if (auto h = histogram.getPhase(phase)) {
+            phase_histograms[name] = h->toDynamic(kQuantiles);
+          }
+        });
+
+    if (!phase_counters.empty() || !phase_histograms.empty()) {
+      phases[phase_names[phase]] = folly::dynamic::object(
+          "counters", std::move(phase_counters))(
+          "histograms", std::move(phase_histograms));
     }
+  }
+
+  histo_map_.forEach([&](const std::string& name, const Histogram& histogram) {
+    histograms[name] = histogram.merged().toDynamic(kQuantiles);
   });
+
+  return folly::dynamic::object("counters", std::move(counters))(
+      "histograms", std::move(histograms))("phases", std::move(phases));
 }
 
-std::shared_ptr<StatisticsManager::Histogram>
-StatisticsManager::getContinuousStat(const std::string& name) {
-  return histo_map_.withWLock([&](auto& m) {
-    auto it = m.find(name);
+std::map<std::string, int64_t> StatisticsManager::getCounters() const {
+  std::map<std::string, int64_t> counters;
+  auto phases = getPhaseNames();
+  count_map_.forEach([&](const std::string& name, const Counter& counter) {
+    counters[name + ".count"] = counter.getCount();
+    for (size_t phase = 0; phase < phases.size(); ++phase) {
+      if (auto c = counter.getPhase(phase)) {
+        counters[folly::sformat("phase.{}.{}.count", phases[phase], name)] =
+            c->getCount();
+      }
+    }
+  });
+  histo_map_.forEach([&](const std::string& name, const Histogram& histogram) {
+    addHistogramCounters(counters, name, histogram.merged());
+    for (size_t phase = 0; phase < phases.size(); ++phase) {
+      if (auto h = histogram.getPhase(phase)) {
+        addHistogramCounters(
+            counters, folly::sformat("phase.{}.{}", phases[phase], name), *h);
+      }
+    }
+  });
+  return counters;
+}
 
-    if (it != m.end()) {
-      return it->second;
-    } else {
-      // We don't want to construct a counter unless we know the counter isn't
-      // there. That does lead to two reads into the map. Oh well.
-      auto ptr = std::make_shared<StatisticsManager::Histogram>();
-      m.emplace(name, ptr);
-      return ptr;
+void StatisticsManager::setCurrentPhase(const std::string& phase) {
+  currentPhase() = phase_names_.withWLock([&](auto& names) {
+    auto it = std::find(names.begin(), names.end(), phase);
+    if (it != names.end()) {
+      return size_t(it - names.begin());
+    }
+    if (names.size() < kMaxPhases - 1) {
+      names.push_back(phase);
+    } else if (names.size() == kMaxPhases - 1) {
+      names.push_back(OVERFLOW_PHASE);
+    }
+    if (names.back() == OVERFLOW_PHASE) {
+      LOG(ERROR) << "More than " << kMaxPhases - 1 << " phases, recording "
+                 << phase << " as " << OVERFLOW_PHASE;
     }
+    return names.size() - 1;
   });
 }
 
+std::vector<std::string> StatisticsManager::getPhaseNames() const {
+  return phase_names_.copy();
+}
+
+std::string StatisticsManager::toJson() {
+  return folly::toJson(toDynamic());
+}
+
+std::shared_ptr<StatisticsManager::Histogram>
+StatisticsManager::getContinuousStat(const std::string& name) {
+  return histo_map_.getShared(name, makeHistogram);
+}
+
 std::shared_ptr<StatisticsManager::Counter> StatisticsManager::getCounterStat(
     const std::string& name) {
-  return count_map_.withWLock([&](auto& m) {
-    // Try and see if the counter is in the map
-    auto it = m.find(name);
+  return count_map_.getShared(
+      name, [&] { return std::make_shared<Counter>(name); });
+}
 
-    if (it != m.end()) {
-      return it->second;
-    } else {
-      // We don't want to construct a counter unless we know the counter isn't
-      // there. That does lead to two reads into the map. Oh well.
-      auto ptr = std::make_shared<StatisticsManager::Counter>(name);
-      m.emplace(name, ptr);
-      return ptr;
+StatisticsManager::Histogram* StatisticsManager::getContinuousStatHandle(
+    const std::string& name) {
+  return histo_map_.get(name, makeHistogram);
+}
+
+StatisticsManager::Counter* StatisticsManager::getCounterStatHandle(
+    const std::string& name) {
+  return count_map_.get(name, [&] { return std::make_shared<Counter>(name); });
+}
+
+WorkerIntervalStatistics* StatisticsManager::getWorkerIntervalStatistics(
+    int worker_id) {
+  return worker_interval_map_.withWLock([&](auto& m) {
+    auto& stats = m[worker_id];
+    if (!stats) {
+      stats = std::make_unique<WorkerIntervalStatistics>(
+          FLAGS_histogram_significant_bits, FLAGS_slow_requests_per_interval);
     }
+    return stats.get();
   });
 }
 
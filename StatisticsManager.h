@@ -10,13 +10,22 @@
 
 #pragma once
 
+#include <map>
 #include <memory>
-#include <unordered_map>
+#include <vector>
 
 #include <folly/Synchronized.h>
-#include <folly/stats/QuantileEstimator.h>
+#include <folly/dynamic.h>
+#include <gflags/gflags.h>
 
 #include "treadmill/CounterStatistic.h"
+#include "treadmill/Histogram.h"
+#include "treadmill/IntervalStatistics.h"
+#include "treadmill/PhasedStatistic.h"
+#include "treadmill/StatisticRegistry.h"
+
+DECLARE_int32(histogram_significant_bits);
+DECLARE_int32(slow_requests_per_interval);
 
 namespace facebook {
 namespace windtunnel {
@@ -24,35 +33,89 @@ namespace treadmill {
 
 // Statistics names are kept here
 const std::string REQUEST_LATENCY = "request_latency";
+// Per-second rates of completed, sent, succeeded and failed requests
 const std::string THROUGHPUT = "throughput";
+const std::string SENT_RATE = "throughput.sent";
+const std::string SUCCESS_RATE = "throughput.succeeded";
+const std::string ERROR_RATE = "throughput.failed";
 const std::string OUTSTANDING_REQUESTS = "outstanding_requests";
 const std::string EXCEPTIONS = "exceptions";
 const std::string UNCAUGHT_EXCEPTIONS = "uncaught_exceptions";
+// From the first send to the last reply of requests that chain follow-ups
+const std::string CHAIN_LATENCY = "chain_latency";
+// Completed requests and errors, broken down by operation
+const std::string REQUESTS = "requests";
+const std::string ERRORS = "errors";
+// Client overhead by stage of a request, with --client_overhead_stats. In
+// nanoseconds, unlike the latencies: stages often take well under a
+// microsecond, and histograms record whole numbers.
+const std::string CLIENT_QUEUE_WAIT = "client.queue_wait_ns";
+const std::string CLIENT_GET_NEXT_REQUEST = "client.get_next_request_ns";
+const std::string CLIENT_SEND_REQUEST = "client.send_request_ns";
+const std::string CLIENT_REPLY_DELAY = "client.reply_delay_ns";
+
+// Phase that statistics are recorded in until a phase is set
+const std::string DEFAULT_PHASE = "default";
+// Phase that absorbs every phase past kMaxPhases
+const std::string OVERFLOW_PHASE = "__overflow__";
 
 class StatisticsManager {
  public:
-  using Histogram = folly::SimpleQuantileEstimator<>;
-  using Counter = CounterStatistic;
-  using HistoMapType =
-      std::unordered_map<std::string, std::shared_ptr<Histogram>>;
-  using CounterMapType =
-      std::unordered_map<std::string, std::shared_ptr<Counter>>;
-
-  StatisticsManager() {}
+  using Histogram = PhasedHistogram;
+  using Counter = PhasedCounter;
+  using HistoMapType = StatisticRegistry<Histogram>;
+  using CounterMapType = StatisticRegistry<Counter>;
+
+  StatisticsManager();
   virtual ~StatisticsManager() {}
 
   void print() const;
+
+  // All counters and histograms, including histogram buckets, over the whole
+  // run and broken down by phase.
+  folly::dynamic toDynamic() const;
   std::string toJson();
 
+  // Summary of every statistic as fb303 counters, over the whole run and
+  // broken down by phase.
+  std::map<std::string, int64_t> getCounters() const;
+
+  // Attribute everything the calling thread records from now on to the given
+  // phase.
+  void setCurrentPhase(const std::string& phase);
+
+  // Names of the phases seen so far, in order of their index.
+  std::vector<std::string> getPhaseNames() const;
+
   static std::shared_ptr<StatisticsManager> get();
   std::shared_ptr<Histogram> getContinuousStat(const std::string& name);
   std::shared_ptr<Counter> getCounterStat(const std::string& name);
 
+  // Lock-free lookups that return handles valid for the lifetime of the
+  // manager. Unlike the shared_ptr versions they don't touch a shared
+  // reference count, so they're cheap enough to call per request.
+  Histogram* getContinuousStatHandle(const std::string& name);
+  Counter* getCounterStatHandle(const std::string& name);
+
+  // Interval statistics of a worker; created on first use and kept alive for
+  // the lifetime of the manager.
+  WorkerIntervalStatistics* getWorkerIntervalStatistics(int worker_id);
+
+  // Interval snapshots published while the run goes on
+  LiveStatistics& getLiveStatistics() {
+    return live_statistics_;
+  }
+
   StatisticsManager(StatisticsManager const&);
   void operator=(StatisticsManager const&);
 
-  folly::Synchronized<HistoMapType> histo_map_;
-  folly::Synchronized<CounterMapType> count_map_;
+  HistoMapType histo_map_;
+  CounterMapType count_map_;
+  folly::Synchronized<std::vector<std::string>> phase_names_;
+  folly::Synchronized<
+      std::map<int, std::unique_ptr<WorkerIntervalStatistics>>>
+      worker_interval_map_;
+  LiveStatistics live_statistics_;
 };
 
 } // namespace treadmill
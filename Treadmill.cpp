@@ -62,12 +62,26 @@ DEFINE_int32(request_per_second, 1024, "The request per second to send.");
 // The total testing time in second
 DEFINE_int32(runtime, 120, "The total runtime in seconds.");
 
+// The file to store the JSON output statistics
+DEFINE_string(
+    output_file,
+    "",
+    "If set, write the results of the run to this file as JSON.");
+
 // The max number of requests to have outstanding per worker
 DEFINE_int32(
     max_outstanding_requests,
     1000,
     "The max number of requests to have outstanding per worker.");
 
+// The max number of prefill requests to have outstanding per worker
+DEFINE_int32(
+    prefill_max_outstanding,
+    1000,
+    "The max number of requests to have outstanding per worker while "
+    "prefilling, before the measured load starts. Prefill requests aren't "
+    "rate limited.");
+
 // Config filename to pass into the workload in JSON format
 DEFINE_string(
     config_in_file,
@@ -93,6 +107,111 @@ DEFINE_string(
     "",
     "Comma-separated list of CPU IDs to pin the workers.");
 
+// Whether to give each NUMA node its own copy of the shared workload state
+DEFINE_bool(
+    numa_replicate_shared_state,
+    false,
+    "With --cpu_affinity, build a copy of the read-only state that workloads "
+    "share for every NUMA node the workers are pinned to, in that node's "
+    "memory.");
+
+DEFINE_string(
+    interval_stats_file,
+    "",
+    "If set, append a snapshot of throughput and latency for every interval "
+    "to this file.");
+
+DEFINE_int32(
+    interval_stats_period_ms,
+    1000,
+    "Length in milliseconds of an interval for --interval_stats_file, and "
+    "how often the throughput and outstanding requests statistics are "
+    "sampled.");
+
+DEFINE_string(
+    interval_stats_format,
+    "json",
+    "Format of --interval_stats_file: 'json' (one object per line) or 'csv'.");
+
+DEFINE_double(
+    adaptive_ci_width,
+    0,
+    "If positive, stop the run as soon as the confidence intervals of the "
+    "--adaptive_quantiles are narrower than this fraction of their estimates, "
+    "e.g. 0.05. --runtime is then the maximum runtime.");
+
+DEFINE_string(
+    adaptive_quantiles,
+    "99,99.9",
+    "Comma-separated latency percentiles that must converge in adaptive mode.");
+
+DEFINE_double(
+    adaptive_confidence,
+    0.95,
+    "Confidence level of the intervals in adaptive mode.");
+
+DEFINE_int32(
+    adaptive_batch_ms,
+    5000,
+    "Minimum length of a batch in adaptive mode. Each batch contributes one "
+    "estimate of every quantile.");
+
+DEFINE_int32(
+    adaptive_min_batches,
+    10,
+    "Number of batches required before an adaptive run may stop (at least "
+    "5).");
+
+DEFINE_int32(
+    adaptive_skip_batches,
+    1,
+    "Number of leading batches ignored as warm-up in adaptive mode.");
+
+DEFINE_string(
+    replay_trace,
+    "",
+    "If set, replay the requests of this trace, as written by "
+    "treadmill_replay_converter, instead of generating them; for workloads "
+    "that support it.");
+
+DEFINE_double(
+    replay_speed,
+    1,
+    "With --replay_trace, send requests this many times faster than they were "
+    "recorded. If 0, ignore the trace timestamps and send at "
+    "--request_per_second.");
+
+DEFINE_bool(
+    client_overhead_stats,
+    false,
+    "Record how long each stage of a request takes inside treadmill, in ns: "
+    "the wait in the worker's queue, getNextRequest(), "
+    "Connection::sendRequest() and the delay before the worker's EventBase "
+    "runs reply callbacks.");
+
+DEFINE_int32(
+    client_overhead_probe_us,
+    1000,
+    "Period in microseconds at which --client_overhead_stats probes the "
+    "EventBase delay of reply callbacks.");
+
+DEFINE_string(
+    trace_dir,
+    "",
+    "If set, every worker records a binary trace of its requests to "
+    "<trace_dir>/trace.<worker>.bin. Read them with treadmill_trace_reader.");
+
+DEFINE_int32(
+    trace_sample_rate,
+    1,
+    "Trace one request in every trace_sample_rate requests.");
+
+DEFINE_int64(
+    trace_max_records,
+    1 << 20,
+    "Number of records in the trace ring of each worker. Once it is full, "
+    "the oldest records are overwritten.");
+
 DEFINE_int32(server_port, -1, "Port for fb303 server");
 
 DEFINE_int32(
@@ -10,6 +10,8 @@
 
 #pragma once
 
+#include <atomic>
+#include <map>
 #include <string>
 #include <thread>
 #include <vector>
@@ -21,8 +23,13 @@
 #include <glog/logging.h>
 
 #include "common/stats/ServiceData.h"
+#include "treadmill/ConvergenceMonitor.h"
+#include "treadmill/IntervalStatistics.h"
+#include "treadmill/RandomEngine.h"
+#include "treadmill/ReplayTrace.h"
 #include "treadmill/Scheduler.h"
 #include "treadmill/TreadmillFB303.h"
+#include "treadmill/Util.h"
 #include "treadmill/Worker.h"
 
 #include "common/fb303/cpp/FacebookBase2.h"
@@ -78,6 +85,9 @@ DECLARE_string(config_out_file);
 // Comma-separated list of CPU IDs to pin the workers
 DECLARE_string(cpu_affinity);
 
+// Whether to give each NUMA node its own copy of the shared workload state
+DECLARE_bool(numa_replicate_shared_state);
+
 // Default number of calibration samples for continuous statistics
 DECLARE_int32(default_calibration_samples);
 
@@ -90,6 +100,39 @@ DECLARE_int32(latency_calibration_samples);
 // Number of warm-up samples for latency statistics
 DECLARE_int32(latency_warmup_samples);
 
+// File to append per-interval throughput and latency snapshots to
+DECLARE_string(interval_stats_file);
+
+// Length of an interval for the interval statistics and the throughput meter
+DECLARE_int32(interval_stats_period_ms);
+
+// Format of the interval statistics file
+DECLARE_string(interval_stats_format);
+
+// Target relative confidence interval width that ends an adaptive run
+DECLARE_double(adaptive_ci_width);
+
+// Latency percentiles that must converge in adaptive mode
+DECLARE_string(adaptive_quantiles);
+
+// Confidence level of the intervals in adaptive mode
+DECLARE_double(adaptive_confidence);
+
+// Minimum length of a batch in adaptive mode
+DECLARE_int32(adaptive_batch_ms);
+
+// Batches required before an adaptive run may stop
+DECLARE_int32(adaptive_min_batches);
+
+// Leading batches ignored in adaptive mode
+DECLARE_int32(adaptive_skip_batches);
+
+// Trace of requests to replay
+DECLARE_string(replay_trace);
+
+// Speed-up of the replay relative to the trace timestamps; 0 to ignore them
+DECLARE_double(replay_speed);
+
 // Port for fb303 server
 DECLARE_int32(server_port);
 
@@ -158,23 +201,107 @@ class TreadmillRunner {
       }
     }
 
+    start_time_ = time_s();
+
     // Init fb303
     std::shared_ptr<std::thread> server_thread;
     if (FLAGS_server_port > 0) {
       TreadmillFB303::make_fb303(server_thread, FLAGS_server_port, *scheduler);
     }
     initializeWorkers();
+    if (!FLAGS_replay_trace.empty() && FLAGS_replay_speed > 0) {
+      // Any copy will do: they all map the same file.
+      auto replay_trace = shared_states_.begin()->second->replay_trace;
+      if (!replay_trace) {
+        replay_trace = std::make_shared<const ReplayTrace>(FLAGS_replay_trace);
+      }
+      scheduler->setReplayTrace(std::move(replay_trace), FLAGS_replay_speed);
+    }
 
-    // Start testing
+    if (FLAGS_adaptive_ci_width > 0) {
+      ConvergenceMonitor::Options options;
+      std::vector<folly::StringPiece> percentiles;
+      folly::split(",", FLAGS_adaptive_quantiles, percentiles, true);
+      for (auto percentile : percentiles) {
+        options.quantiles.push_back(folly::to<double>(percentile) / 100);
+      }
+      options.target_relative_width = FLAGS_adaptive_ci_width;
+      options.confidence = FLAGS_adaptive_confidence;
+      options.batch_ms = FLAGS_adaptive_batch_ms;
+      options.min_batches = FLAGS_adaptive_min_batches;
+      options.skip_batches = FLAGS_adaptive_skip_batches;
+      options.significant_bits = FLAGS_histogram_significant_bits;
+      convergence_monitor_ =
+          std::make_unique<ConvergenceMonitor>(std::move(options));
+    }
+
+    // Start the workers and load what the workload needs before anything is
+    // measured.
     for (int i = 0; i < FLAGS_number_of_workers; i++) {
       workers[i]->run();
     }
+    prefill();
+
+    // Besides the interval statistics file, the interval snapshots feed live
+    // statistics, the slowest requests and adaptive runs, so always report.
+    auto manager = StatisticsManager::get();
+    std::vector<WorkerIntervalStatistics*> interval_stats;
+    for (int i = 0; i < FLAGS_number_of_workers; i++) {
+      interval_stats.push_back(manager->getWorkerIntervalStatistics(i));
+    }
+    IntervalReporter interval_reporter(
+        std::move(interval_stats),
+        FLAGS_interval_stats_file,
+        IntervalReporter::parseFormat(FLAGS_interval_stats_format),
+        FLAGS_interval_stats_period_ms,
+        FLAGS_histogram_significant_bits);
+    interval_reporter.addListener(
+        [live_statistics = &manager->getLiveStatistics()](
+            const IntervalSnapshot& snapshot) {
+          live_statistics->publish(snapshot);
+        });
+    // The interval snapshots are also the throughput meter: every full
+    // interval while requests are being scheduled is one sample of each rate,
+    // attributed to the phase the workers are in.
+    std::atomic<bool> sampling_rates{true};
+    interval_reporter.addListener(
+        [&sampling_rates,
+         min_interval_s = FLAGS_interval_stats_period_ms / 2000.0,
+         throughput = manager->getContinuousStatHandle(THROUGHPUT),
+         sent_rate = manager->getContinuousStatHandle(SENT_RATE),
+         success_rate = manager->getContinuousStatHandle(SUCCESS_RATE),
+         error_rate = manager->getContinuousStatHandle(ERROR_RATE),
+         outstanding = manager->getContinuousStatHandle(OUTSTANDING_REQUESTS)](
+            const IntervalSnapshot& snapshot) {
+          if (!sampling_rates.load(std::memory_order_relaxed) ||
+              snapshot.interval_s < min_interval_s) {
+            return;
+          }
+          auto phase = snapshot.phase;
+          throughput->forPhase(phase).addValue(snapshot.throughput);
+          sent_rate->forPhase(phase).addValue(snapshot.sent_rate);
+          success_rate->forPhase(phase).addValue(snapshot.success_rate);
+          error_rate->forPhase(phase).addValue(snapshot.error_rate);
+          outstanding->forPhase(phase).addValue(snapshot.outstanding);
+        });
+    if (convergence_monitor_) {
+      interval_reporter.addListener(
+          [monitor = convergence_monitor_.get()](
+              const IntervalSnapshot& snapshot) {
+            monitor->addInterval(*snapshot.latency, snapshot.interval_s);
+          });
+    }
+    interval_reporter.start();
 
     // Start the test and wait for it to finish.
     std::vector<folly::SemiFuture<folly::Unit>> futs;
     futs.push_back(scheduler->run());
     futs.push_back(folly::futures::sleep(std::chrono::seconds(FLAGS_runtime)));
+    if (convergence_monitor_) {
+      futs.push_back(convergence_monitor_->getConvergedFuture());
+    }
     folly::collectAny(futs).wait();
+    sampling_rates = false;
 
     LOG(INFO) << "Stopping and joining scheduler thread";
     scheduler->stop();
@@ -198,7 +325,16 @@ class TreadmillRunner {
       } while (secondsToWait > 0 && remaining > 0);
     }
 
+    interval_reporter.stop();
+
     StatisticsManager::get()->print();
+    if (convergence_monitor_) {
+      convergence_monitor_->print();
+    }
+    if (FLAGS_output_file != "") {
+      LOG(INFO) << "Writing results to " << FLAGS_output_file;
+      writeDynamicToFileAtomically(FLAGS_output_file, makeResults());
+    }
     LOG(INFO) << "Stopping workers";
 
     // We already stored stats, so just drop all remaining scheduled request.
@@ -231,6 +367,72 @@ class TreadmillRunner {
     return 0;
   }
 
+  /**
+   * The result document of the run: metadata, the configuration that
+   * produced it and every statistic.
+   */
+  virtual folly::dynamic makeResults() {
+    folly::dynamic flags = folly::dynamic::object;
+    std::vector<gflags::CommandLineFlagInfo> all_flags;
+    gflags::GetAllFlags(&all_flags);
+    for (const auto& flag : all_flags) {
+      flags[flag.name] = flag.current_value;
+    }
+
+    auto results = StatisticsManager::get()->toDynamic();
+    results["metadata"] = folly::dynamic::object("start_time", start_time_)(
+        "end_time", time_s())("hostname", FLAGS_hostname)(
+        "number_of_workers", FLAGS_number_of_workers)(
+        "number_of_connections", FLAGS_number_of_connections)(
+        "random_seed", folly::to<std::string>(RandomEngine::getSeed()));
+    results["configuration"] =
+        folly::dynamic::object("flags", std::move(flags))("workload", config);
+    if (convergence_monitor_) {
+      results["precision"] = convergence_monitor_->toDynamic();
+    }
+    if (!prefill_results_.isNull()) {
+      results["prefill"] = prefill_results_;
+    }
+    if (!workers.empty()) {
+      auto labels = workers[0]->getOperationLabels();
+      folly::dynamic slow_requests = folly::dynamic::array;
+      for (const auto& request :
+           StatisticsManager::get()->getLiveStatistics().getSlowestRequests()) {
+        slow_requests.push_back(request.toDynamic(labels));
+      }
+      results["slowest_requests"] = std::move(slow_requests);
+    }
+    return results;
+  }
+
+  /**
+   * Runs the prefill stage of every worker in parallel and waits for all of
+   * them. Nothing is rate limited, and the scheduler isn't started until the
+   * last worker is done.
+   */
+  void prefill() {
+    auto start_time = time_s();
+    std::vector<folly::SemiFuture<PrefillStats>> futs;
+    for (auto& worker : workers) {
+      futs.push_back(worker->prefill());
+    }
+    PrefillStats total;
+    for (auto& stats : folly::collectAll(futs).get()) {
+      total.requests += stats.value().requests;
+      total.errors += stats.value().errors;
+    }
+    if (total.requests == 0) {
+      return;
+    }
+    double seconds = time_s() - start_time;
+    LOG(INFO) << "Prefilled with " << total.requests << " requests ("
+              << total.errors << " failed) in " << seconds << " s, "
+              << total.requests / seconds << " requests/s";
+    prefill_results_ = folly::dynamic::object("requests", total.requests)(
+        "errors", total.errors)("seconds", seconds)(
+        "throughput", total.requests / seconds);
+  }
+
   virtual void initializeWorkers() {
     for (int i = 0; i < FLAGS_number_of_workers; i++) {
       workers.push_back(std::make_unique<Worker<Service>>(
@@ -241,8 +443,40 @@ class TreadmillRunner {
           max_outstanding_requests_per_worker,
           config,
           cpu_affinity_list[i],
-          terminate_early_fn));
+          terminate_early_fn,
+          getSharedState(cpu_affinity_list[i])));
+    }
+  }
+
+  /**
+   * The shared workload state for a worker pinned to cpu, or -1 if it isn't
+   * pinned: one for the whole run or, with --numa_replicate_shared_state, one
+   * per NUMA node. It's built on a thread pinned to cpu, so that pages are
+   * first touched, and thus allocated, on that node.
+   */
+  std::shared_ptr<const typename Workload<Service>::SharedState>
+  getSharedState(int cpu) {
+    int node = -1;
+    if (FLAGS_numa_replicate_shared_state && cpu >= 0) {
+      node = getNumaNode(cpu);
+    }
+    auto it = shared_states_.find(node);
+    if (it != shared_states_.end()) {
+      return it->second;
+    }
+    std::shared_ptr<const typename Workload<Service>::SharedState> state;
+    std::thread builder([&] {
+      if (node >= 0 && !setCpuAffinity(cpu)) {
+        LOG(ERROR) << "Failed to set CPU affinity";
+      }
+      state = Workload<Service>::makeSharedState(config);
+    });
+    builder.join();
+    if (node >= 0) {
+      LOG(INFO) << "Built the shared workload state for NUMA node " << node;
     }
+    shared_states_[node] = state;
+    return state;
   }
 
  protected:
@@ -255,6 +489,14 @@ class TreadmillRunner {
 
  private:
   double rps;
+  double start_time_{0};
+  // Only set if the workload has a prefill stage
+  folly::dynamic prefill_results_{nullptr};
+  // By NUMA node, or -1 for workers that don't need their own
+  std::map<int, std::shared_ptr<const typename Workload<Service>::SharedState>>
+      shared_states_;
+  // Only set in adaptive mode (--adaptive_ci_width)
+  std::unique_ptr<ConvergenceMonitor> convergence_monitor_;
 };
 
 void init(int argc, char* argv[]);
@@ -12,10 +12,13 @@
 #include "thrift/lib/cpp/util/EnumUtils.h"
 
 #include "Scheduler.h"
+#include "StatisticsManager.h"
 
+#include <algorithm>
 #include <memory>
 
 #include <folly/Conv.h>
+#include <folly/Format.h>
 #include <folly/Singleton.h>
 #include <thrift/lib/cpp2/server/ThriftServer.h>
 #include "common/services/cpp/TLSConfig.h"
@@ -31,9 +34,16 @@ DEFINE_bool(
     "If true, a watchdog timer will be maintained during a run.");
 
 using fb_status = facebook::fb303::cpp2::fb_status;
+using ::treadmill::HistogramBucket;
+using ::treadmill::IntervalStats;
+using ::treadmill::LatencyHistogram;
+using ::treadmill::LiveStatsRequest;
+using ::treadmill::LiveStatsResponse;
 using ::treadmill::RateResponse;
 using ::treadmill::ResumeRequest;
 using ::treadmill::ResumeResponse;
+using ::treadmill::SlowRequestInfo;
+using ::treadmill::WorkerStats;
 
 using namespace facebook::services;
 
@@ -41,6 +51,98 @@ namespace facebook {
 namespace windtunnel {
 namespace treadmill {
 
+namespace {
+
+LatencyHistogram toLatencyHistogram(
+    const Histogram& histogram,
+    const LiveStatsRequest& req) {
+  LatencyHistogram result;
+  result.count_ref() = histogram.getCount();
+  result.avg_ref() = histogram.getMean();
+  result.min_ref() = histogram.getMin();
+  result.max_ref() = histogram.getMax();
+  const auto& quantiles = *req.quantiles_ref();
+  auto values = histogram.getQuantiles(quantiles);
+  for (size_t i = 0; i < quantiles.size(); ++i) {
+    (*result.quantiles_ref())[folly::sformat("p{:g}", quantiles[i] * 100)] =
+        values[i];
+  }
+  if (*req.include_buckets_ref()) {
+    std::vector<HistogramBucket> buckets;
+    histogram.forEachBucket(
+        [&](uint64_t lower, uint64_t upper, uint64_t count) {
+          HistogramBucket bucket;
+          bucket.lower_bound_ref() = lower;
+          bucket.upper_bound_ref() = upper;
+          bucket.count_ref() = count;
+          buckets.push_back(std::move(bucket));
+        });
+    result.buckets_ref() = std::move(buckets);
+  }
+  return result;
+}
+
+std::vector<SlowRequestInfo> toSlowRequestInfos(
+    const std::vector<SlowRequest>& requests) {
+  std::vector<SlowRequestInfo> result;
+  for (const auto& request : requests) {
+    SlowRequestInfo info;
+    info.latency_ref() = request.latency;
+    info.send_time_ns_ref() = request.send_time_ns;
+    info.key_ref() = request.key.get().str();
+    info.worker_ref() = request.worker;
+    info.connection_ref() = request.connection;
+    info.operation_ref() = request.operation;
+    info.error_ref() = request.error;
+    result.push_back(std::move(info));
+  }
+  return result;
+}
+
+// Merges consecutive intervals, given oldest first, into one.
+IntervalStats toIntervalStats(
+    const std::vector<IntervalSnapshot>& intervals,
+    const LiveStatsRequest& req) {
+  Histogram latency(intervals.front().latency->getSignificantBits());
+  IntervalStats result;
+  result.sequence_ref() = intervals.front().sequence;
+  result.elapsed_s_ref() = intervals.back().elapsed_s;
+  result.outstanding_ref() = intervals.back().outstanding;
+  double interval_s = 0;
+  int64_t sent = 0, completed = 0, dropped = 0, errors = 0;
+  std::vector<SlowRequest> slow_requests;
+  for (const auto& interval : intervals) {
+    mergeSlowRequests(
+        slow_requests,
+        interval.slow_requests,
+        std::max(slow_requests.size(), interval.slow_requests.size()));
+    interval_s += interval.interval_s;
+    sent += interval.sent;
+    completed += interval.completed;
+    dropped += interval.dropped;
+    errors += interval.errors;
+    latency.merge(*interval.latency);
+  }
+  result.interval_s_ref() = interval_s;
+  result.sent_ref() = sent;
+  result.completed_ref() = completed;
+  result.dropped_ref() = dropped;
+  result.errors_ref() = errors;
+  if (interval_s > 0) {
+    result.sent_rate_ref() = sent / interval_s;
+    result.throughput_ref() = completed / interval_s;
+    result.success_rate_ref() = (completed - errors) / interval_s;
+    result.error_rate_ref() = errors / interval_s;
+  } else {
+    result.throughput_ref() = 0.0;
+  }
+  result.latency_ref() = toLatencyHistogram(latency, req);
+  result.slow_requests_ref() = toSlowRequestInfos(slow_requests);
+  return result;
+}
+
+} // namespace
+
 TreadmillFB303::TreadmillFB303(Scheduler& scheduler)
     : FacebookBase2("Treadmill"),
       status_(fb_status::STARTING),
@@ -73,6 +175,8 @@ int64_t TreadmillFB303::aliveSince() {
 
 void TreadmillFB303::getCounters(std::map<std::string, int64_t>& _return) {
   fb303::FacebookBase2::getCounters(_return);
+  auto statistics = StatisticsManager::get()->getCounters();
+  _return.insert(statistics.begin(), statistics.end());
 }
 
 bool TreadmillFB303::pause() {
@@ -129,6 +233,37 @@ TreadmillFB303::future_getRate() {
   return folly::makeFuture(std::move(response));
 }
 
+folly::Future<std::unique_ptr<LiveStatsResponse>>
+TreadmillFB303::future_getLiveStats(std::unique_ptr<LiveStatsRequest> req) {
+  auto& live_statistics = StatisticsManager::get()->getLiveStatistics();
+  auto intervals = live_statistics.getIntervals(
+      std::max(*req->window_intervals_ref(), 1));
+  auto response = std::make_unique<LiveStatsResponse>();
+  response->available_ref() = !intervals.empty();
+  if (intervals.empty()) {
+    return folly::makeFuture(std::move(response));
+  }
+
+  response->last_interval_ref() = toIntervalStats({intervals.back()}, *req);
+  response->window_ref() = toIntervalStats(intervals, *req);
+  response->cumulative_latency_ref() =
+      toLatencyHistogram(*live_statistics.getCumulativeLatency(), *req);
+  const auto& workers = intervals.back().workers;
+  for (size_t i = 0; i < workers.size(); ++i) {
+    WorkerStats worker;
+    worker.worker_id_ref() = i;
+    worker.sent_ref() = workers[i].sent;
+    worker.completed_ref() = workers[i].completed;
+    worker.dropped_ref() = workers[i].dropped;
+    worker.errors_ref() = workers[i].errors;
+    worker.outstanding_ref() = workers[i].outstanding;
+    response->workers_ref()->push_back(std::move(worker));
+  }
+  response->slowest_requests_ref() =
+      toSlowRequestInfos(live_statistics.getSlowestRequests());
+  return folly::makeFuture(std::move(response));
+}
+
 folly::Future<std::unique_ptr<std::string>>
 TreadmillFB303::future_getConfiguration(std::unique_ptr<std::string> key) {
   LOG(INFO) << "TreadmillHandler::getConfiguration: " << *key;
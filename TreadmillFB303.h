@@ -45,6 +45,9 @@ class TreadmillFB303 : public facebook::fb303::FacebookBase2,
   void setMaxOutstanding(int32_t max_outstanding) override;
   folly::Future<std::unique_ptr<::treadmill::RateResponse>> future_getRate()
       override;
+  folly::Future<std::unique_ptr<::treadmill::LiveStatsResponse>>
+  future_getLiveStats(std::unique_ptr<::treadmill::LiveStatsRequest> req)
+      override;
 
   folly::Future<std::unique_ptr<std::string>> future_getConfiguration(
       std::unique_ptr<std::string> key) override;
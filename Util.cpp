@@ -11,12 +11,18 @@
 #include "treadmill/Util.h"
 
 #include <arpa/inet.h>
+#include <dirent.h>
 #include <netdb.h>
+#include <sched.h>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 
 #include <sys/time.h>
+#include <unistd.h>
 
+#include <folly/Format.h>
 #include <folly/json.h>
 #include <glog/logging.h>
 
@@ -74,6 +80,19 @@ void writeDynamicToFile(std::string filename, folly::dynamic object) {
   }
 }
 
+void writeDynamicToFileAtomically(
+    std::string filename,
+    folly::dynamic object) {
+  std::string json = folly::toJson(object);
+  std::string tmp_filename = folly::sformat("{}.tmp.{}", filename, getpid());
+  if (!writeStringToFile(json, tmp_filename)) {
+    LOG(FATAL) << "Open to write failed: " << tmp_filename;
+  }
+  if (rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+    PLOG(FATAL) << "Failed to rename " << tmp_filename << " to " << filename;
+  }
+}
+
 folly::dynamic readDynamicFromFile(std::string filename) {
   std::string s;
   if (!readFileToString(filename, s)) {
@@ -157,6 +176,32 @@ double time_s() {
   return time_stamp.tv_sec + time_stamp.tv_usec * 1e-6;
 }
 
+bool setCpuAffinity(int cpu) {
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  CPU_SET(cpu, &mask);
+  return sched_setaffinity(0, sizeof(cpu_set_t), &mask) == 0;
+}
+
+int getNumaNode(int cpu) {
+  // The CPU's directory has a nodeN link to its node.
+  auto path = folly::sformat("/sys/devices/system/cpu/cpu{}", cpu);
+  DIR* dir = opendir(path.c_str());
+  if (dir == nullptr) {
+    return -1;
+  }
+  int node = -1;
+  while (struct dirent* entry = readdir(dir)) {
+    if (strncmp(entry->d_name, "node", 4) == 0 &&
+        sscanf(entry->d_name + 4, "%d", &node) == 1) {
+      break;
+    }
+    node = -1;
+  }
+  closedir(dir);
+  return node;
+}
+
 /**
  * Loop up the IP address given hostname; return the first ip address
  * returned by getaddrinfo; if error occurs, return non-zero error code.
@@ -30,6 +30,12 @@ int64_t nowNs();
 
 void writeDynamicToFile(std::string filename, folly::dynamic);
 
+/**
+ * Write the JSON of object to a temporary file next to filename and rename it
+ * into place, so readers never observe a partially written file.
+ */
+void writeDynamicToFileAtomically(std::string filename, folly::dynamic object);
+
 folly::dynamic readDynamicFromFile(std::string filename);
 
 /**
@@ -64,6 +70,22 @@ std::string nsLookUp(const std::string& hostname);
 
 double time_s();
 
+/**
+ * Pin the calling thread to a CPU
+ *
+ * @param cpu The CPU ID
+ * @return Whether the thread was pinned
+ */
+bool setCpuAffinity(int cpu);
+
+/**
+ * Look up the NUMA node a CPU belongs to in sysfs
+ *
+ * @param cpu The CPU ID
+ * @return The node ID, or -1 if it isn't known
+ */
+int getNumaNode(int cpu);
+
 } // namespace treadmill
 } // namespace windtunnel
 } // namespace facebook
@@ -0,0 +1,30 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include "treadmill/ValuePool.h"
+
+#include <random>
+
+namespace facebook {
+namespace windtunnel {
+namespace treadmill {
+
+ValuePool::ValuePool(size_t max_size)
+    : max_size_(max_size), data_(max_size + kOffsets) {
+  // Printable and hard to compress, the same in every run
+  std::mt19937_64 engine(0);
+  for (auto& c : data_) {
+    c = 'a' + engine() % 26;
+  }
+}
+
+} // namespace treadmill
+} // namespace windtunnel
+} // namespace facebook
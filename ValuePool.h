@@ -0,0 +1,53 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <folly/io/IOBuf.h>
+
+namespace facebook {
+namespace windtunnel {
+namespace treadmill {
+
+/**
+ * Pre-generated bytes that values are served from, shared by the workers.
+ *
+ * wrap() returns an IOBuf that points into the pool without owning it, so a
+ * value costs neither an allocation nor a copy however large it is. Values
+ * start at one of kOffsets places so they aren't all identical.
+ */
+class ValuePool {
+ public:
+  static constexpr size_t kOffsets = 4096;
+
+  // The memory is allocated by the calling thread.
+  explicit ValuePool(size_t max_size);
+
+  // A value of size bytes; which bytes depends on variant.
+  folly::IOBuf wrap(size_t size, uint64_t variant) const {
+    return folly::IOBuf(
+        folly::IOBuf::WRAP_BUFFER, data_.data() + variant % kOffsets, size);
+  }
+
+  size_t getMaxSize() const {
+    return max_size_;
+  }
+
+ private:
+  const size_t max_size_;
+  std::vector<char> data_;
+};
+
+} // namespace treadmill
+} // namespace windtunnel
+} // namespace facebook
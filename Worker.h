@@ -10,8 +10,6 @@
 
 #pragma once
 
-#include <sched.h>
-
 #include <memory>
 #include <thread>
 
@@ -27,6 +25,9 @@
 
 #include "treadmill/Connection.h"
 #include "treadmill/Event.h"
+#include "treadmill/LoopLagProbe.h"
+#include "treadmill/RandomEngine.h"
+#include "treadmill/RequestTrace.h"
 #include "treadmill/StatisticsManager.h"
 #include "treadmill/Util.h"
 #include "treadmill/Workload.h"
@@ -34,6 +35,12 @@
 DECLARE_bool(wait_for_target_ready);
 DECLARE_string(counter_name);
 DECLARE_int32(counter_threshold);
+DECLARE_bool(client_overhead_stats);
+DECLARE_int32(client_overhead_probe_us);
+DECLARE_int32(prefill_max_outstanding);
+DECLARE_string(trace_dir);
+DECLARE_int32(trace_sample_rate);
+DECLARE_int64(trace_max_records);
 
 namespace facebook {
 namespace windtunnel {
@@ -42,6 +49,12 @@ namespace treadmill {
 constexpr folly::StringPiece kOutstandingRequestsCounter =
     "outstanding_requests";
 
+// What a worker sent while prefilling
+struct PrefillStats {
+  uint64_t requests{0};
+  uint64_t errors{0};
+};
+
 template <class Service>
 class Worker : private folly::NotificationQueue<Event>::Consumer {
  public:
@@ -53,7 +66,9 @@ class Worker : private folly::NotificationQueue<Event>::Consumer {
       int max_outstanding_requests,
       const folly::dynamic& config,
       int cpu_affinity,
-      std::function<void()> terminate_early_fn)
+      std::function<void()> terminate_early_fn,
+      std::shared_ptr<const typename Workload<Service>::SharedState>
+          shared_state = nullptr)
       : worker_id_(worker_id),
         number_of_workers_(number_of_workers),
         number_of_connections_(number_of_connections),
@@ -61,13 +76,29 @@ class Worker : private folly::NotificationQueue<Event>::Consumer {
         workload_(config),
         cpu_affinity_(cpu_affinity),
         queue_(queue),
-        terminate_early_fn_(terminate_early_fn) {
+        terminate_early_fn_(terminate_early_fn),
+        // Workers created without shared state build their own.
+        shared_state_(
+            shared_state ? std::move(shared_state)
+                         : Workload<Service>::makeSharedState(config)) {
+    workload_.setSharedState(shared_state_);
+    workload_.setWorker(worker_id_, number_of_workers_);
+    workload_.seed(
+        RandomEngine::deriveSeed(RandomEngine::getSeed(), worker_id_));
     for (int i = 0; i < number_of_connections_; i++) {
       connections_.push_back(
           std::make_unique<Connection<Service>>(event_base_));
     }
 
     setWorkerCounter(kOutstandingRequestsCounter, 0);
+
+    if (!FLAGS_trace_dir.empty()) {
+      trace_writer_ = std::make_unique<RequestTraceWriter>(
+          folly::sformat("{}/trace.{}.bin", FLAGS_trace_dir, worker_id_),
+          worker_id_,
+          FLAGS_trace_max_records,
+          FLAGS_trace_sample_rate);
+    }
   }
 
   Worker(
@@ -79,7 +110,9 @@ class Worker : private folly::NotificationQueue<Event>::Consumer {
       const folly::dynamic& config,
       int cpu_affinity,
       std::function<void()> terminate_early_fn,
-      Workload<Service> workload)
+      Workload<Service> workload,
+      std::shared_ptr<const typename Workload<Service>::SharedState>
+          shared_state = nullptr)
       : Worker(
             worker_id,
             queue,
@@ -88,8 +121,13 @@ class Worker : private folly::NotificationQueue<Event>::Consumer {
             max_outstanding_requests,
             config,
             cpu_affinity,
-            terminate_early_fn) {
+            terminate_early_fn,
+            std::move(shared_state)) {
     workload_ = workload;
+    workload_.setSharedState(shared_state_);
+    workload_.setWorker(worker_id_, number_of_workers_);
+    workload_.seed(
+        RandomEngine::deriveSeed(RandomEngine::getSeed(), worker_id_));
   }
 
   ~Worker() override {}
@@ -118,6 +156,19 @@ class Worker : private folly::NotificationQueue<Event>::Consumer {
         std::make_unique<std::thread>([this] { this->senderLoop(); });
   }
 
+  /**
+   * Sends the workload's prefill requests, spread over the connections, as
+   * fast as the server answers them with up to --prefill_max_outstanding in
+   * flight. Nothing is rate limited or recorded in the request statistics.
+   * Call after run(); the future completes once every prefill request is
+   * answered.
+   */
+  folly::SemiFuture<PrefillStats> prefill() {
+    auto future = prefill_promise_.getSemiFuture();
+    event_base_.runInEventBaseThread([this] { sendPrefillRequests(); });
+    return future;
+  }
+
   void stop() {
     running_.store(false);
     auto stopper = [this]() { event_base_.terminateLoopSoon(); };
@@ -133,6 +184,10 @@ class Worker : private folly::NotificationQueue<Event>::Consumer {
     return running_ || outstanding_requests_ > 0;
   }
 
+  std::vector<std::string> getOperationLabels() const {
+    return workload_.getOperationLabels();
+  }
+
   folly::dynamic makeConfigOutputs(std::vector<Worker*> worker_refs) {
     std::vector<Workload<Service>*> workload_refs;
     for (auto worker : worker_refs) {
@@ -159,25 +214,43 @@ class Worker : private folly::NotificationQueue<Event>::Consumer {
    */
   void senderLoop() {
     folly::setThreadName("treadmill-wrkr");
-    if (cpu_affinity_ != -1) {
-      cpu_set_t mask;
-      CPU_ZERO(&mask);
-      CPU_SET(cpu_affinity_, &mask);
-      if (sched_setaffinity(0, sizeof(cpu_set_t), &mask)) {
-        LOG(ERROR) << "Failed to set CPU affinity";
-      }
+    // The scheduler has stream 0
+    ThreadSafeRandomEngine::setStream(worker_id_ + 1);
+    if (cpu_affinity_ != -1 && !setCpuAffinity(cpu_affinity_)) {
+      LOG(ERROR) << "Failed to set CPU affinity";
     }
     auto manager = StatisticsManager::get();
-    outstanding_statistic_ = manager->getContinuousStat(OUTSTANDING_REQUESTS);
-    throughput_statistic_ = manager->getContinuousStat(THROUGHPUT);
     latency_statistic_ = manager->getContinuousStat(REQUEST_LATENCY);
     exceptions_statistic_ = manager->getCounterStat(EXCEPTIONS);
     uncaught_exceptions_statistic_ =
         manager->getCounterStat(UNCAUGHT_EXCEPTIONS);
-    last_throughput_time_ = nowNs();
+    interval_statistic_ = manager->getWorkerIntervalStatistics(worker_id_);
+    for (const auto& label : workload_.getOperationLabels()) {
+      operation_statistics_.push_back(
+          {manager->getContinuousStatHandle(
+               folly::sformat("{}.{}", REQUEST_LATENCY, label)),
+           manager->getCounterStatHandle(
+               folly::sformat("{}.{}", REQUESTS, label)),
+           manager->getCounterStatHandle(
+               folly::sformat("{}.{}", ERRORS, label))});
+    }
+    if (FLAGS_client_overhead_stats) {
+      queue_wait_statistic_ =
+          manager->getContinuousStatHandle(CLIENT_QUEUE_WAIT);
+      get_next_request_statistic_ =
+          manager->getContinuousStatHandle(CLIENT_GET_NEXT_REQUEST);
+      send_request_statistic_ =
+          manager->getContinuousStatHandle(CLIENT_SEND_REQUEST);
+      loop_lag_probe_ = std::make_unique<LoopLagProbe>(
+          event_base_,
+          manager->getContinuousStatHandle(CLIENT_REPLY_DELAY),
+          FLAGS_client_overhead_probe_us);
+      loop_lag_probe_->start();
+    }
 
     startConsuming(&event_base_, &queue_);
     event_base_.loopForever();
+    loop_lag_probe_.reset();
   }
 
   void messageAvailable(Event&& event) noexcept override {
@@ -193,7 +266,10 @@ class Worker : private folly::NotificationQueue<Event>::Consumer {
       LOG(INFO) << "Got EventType::RESET";
       workload_.reset();
     } else if (event.getEventType() == EventType::SEND_REQUEST) {
-      sendRequest();
+      if (queue_wait_statistic_ && event.getTimestampNs() != 0) {
+        queue_wait_statistic_->addValue(nowNs() - event.getTimestampNs());
+      }
+      sendRequest(event.getTimestampNs());
     } else if (event.getEventType() == EventType::SET_MAX_OUTSTANDING) {
       auto extraData = event.getExtraData();
       if (!extraData.isInt()) {
@@ -210,15 +286,204 @@ class Worker : private folly::NotificationQueue<Event>::Consumer {
       } else {
         LOG(INFO) << "Got EventType::SET_PHASE = " << extraData.asString();
         workload_.setPhase(extraData.asString());
+        // Replies are handled on this thread too, so from here on everything
+        // this worker records is attributed to the new phase.
+        StatisticsManager::get()->setCurrentPhase(extraData.asString());
+        interval_statistic_->setPhase(currentPhase());
       }
     } else {
       LOG(ERROR) << "Got unhandled event: " << int(event.getEventType());
     }
   }
 
-  void sendRequest() {
+  // Tops up the prefill requests in flight; called again by every reply.
+  void sendPrefillRequests() {
+    while (!prefill_done_ &&
+           prefill_outstanding_ < FLAGS_prefill_max_outstanding) {
+      auto request_tuple = workload_.getNextPrefillRequest();
+      if (std::get<0>(request_tuple) == nullptr) {
+        prefill_done_ = true;
+        break;
+      }
+      auto pw = folly::makeMoveWrapper(std::move(std::get<1>(request_tuple)));
+      ++prefill_outstanding_;
+      auto conn_idx = conn_idx_;
+      conn_idx_ = (conn_idx_ + 1) % number_of_connections_;
+      connections_[conn_idx]
+          ->sendRequest(std::move(std::get<0>(request_tuple)))
+          .thenTry([this, pw](folly::Try<typename Service::Reply>&& t) mutable {
+            ++prefill_stats_.requests;
+            if (t.hasException()) {
+              ++prefill_stats_.errors;
+              pw->setException(t.exception());
+            } else {
+              pw->setValue(std::move(t.value()));
+            }
+            --prefill_outstanding_;
+            sendPrefillRequests();
+          });
+    }
+    if (prefill_done_ && prefill_outstanding_ == 0 &&
+        !prefill_promise_.isFulfilled()) {
+      prefill_promise_.setValue(prefill_stats_);
+    }
+  }
+
+  /**
+   * Sends request on connection conn_idx, records its statistics once it's
+   * answered, then calls callback with the reply. Every request goes through
+   * here, whether the scheduler asked for it or it follows up on another.
+   */
+  template <class Callback>
+  void send(
+      std::unique_ptr<typename Service::Request> request,
+      int64_t intended_time,
+      size_t conn_idx,
+      bool traced,
+      Callback callback) {
+    auto operation = request->getOperation();
+    auto payload_size = request->getPayloadSize();
+    // Only turned into a SlowRequestKey, which copies it, if the request is
+    // one of the slowest
+    folly::IOBuf key;
+    if (FLAGS_slow_requests_per_interval > 0) {
+      key = request->shareKey();
+    }
+    CHECK_LT(operation, operation_statistics_.size())
+        << "Request operation isn't one of the workload's operation labels";
+    auto send_time = nowNs();
+
+    auto sent = connections_[conn_idx]->sendRequest(std::move(request));
+    interval_statistic_->addSent();
+    if (send_request_statistic_) {
+      send_request_statistic_->addValue(nowNs() - send_time);
+    }
+
+    std::move(sent).thenTry(
+        [send_time,
+         operation,
+         traced,
+         intended_time,
+         payload_size,
+         conn_idx,
+         key = std::move(key),
+         this,
+         callback](folly::Try<typename Service::Reply>&& t) mutable {
+          auto recv_time = nowNs();
+          if (traced) {
+            trace_writer_->record(
+                {intended_time,
+                 send_time,
+                 recv_time,
+                 uint32_t(conn_idx),
+                 payload_size,
+                 uint16_t(worker_id_),
+                 uint16_t(operation),
+                 t.hasException() ? TraceStatus::ERROR : TraceStatus::OK,
+                 {}});
+          }
+          auto& op_statistics = operation_statistics_[operation];
+          if (running_) {
+            // If the worker is not in running state, latency stat have
+            // already been released
+            double latency = (recv_time - send_time) / 1000.0;
+            latency_statistic_->addValue(latency);
+            op_statistics.latency->addValue(latency);
+            interval_statistic_->addLatency(latency);
+            if (interval_statistic_->isSlowRequest(latency)) {
+              interval_statistic_->addSlowRequest(
+                  {latency,
+                   send_time,
+                   SlowRequestKey(folly::StringPiece(
+                       reinterpret_cast<const char*>(key.data()),
+                       key.length())),
+                   uint32_t(worker_id_),
+                   uint32_t(conn_idx),
+                   operation,
+                   t.hasException()});
+            }
+          }
+          op_statistics.requests->increase(1);
+          if (t.hasException()) {
+            op_statistics.errors->increase(1);
+          }
+          interval_statistic_->addCompleted(t.hasException());
+          if (t.hasException()) {
+            n_exceptions_by_type_[t.exception().class_name().toStdString()]++;
+            LOG(INFO) << t.exception().what();
+          }
+          callback(std::move(t));
+        });
+  }
+
+  // A copy of request to pass to getFollowUpRequest() once it's answered, or
+  // nullptr if the workload won't follow up on it.
+  std::unique_ptr<typename Service::Request> retainForFollowUp(
+      const typename Service::Request& request) const {
+    if (!workload_.mayFollowUp(request)) {
+      return nullptr;
+    }
+    return std::make_unique<typename Service::Request>(request);
+  }
+
+  /**
+   * Called with the reply to each request of a chain: sends the follow-up
+   * the workload asks for, if any, on the same connection, or else ends the
+   * chain and records its latency. Follow-ups hold on to the outstanding
+   * slot of the request that started the chain rather than taking a
+   * scheduler token of their own, so they don't change the arrival process.
+   */
+  void continueChain(
+      std::unique_ptr<typename Service::Request> request,
+      const folly::Try<typename Service::Reply>& reply,
+      int64_t chain_start,
+      size_t conn_idx,
+      bool traced) {
+    std::unique_ptr<typename Service::Request> next;
+    if (request && reply.hasValue() && running_) {
+      next = workload_.getFollowUpRequest(*request, reply.value());
+    }
+    if (!next) {
+      if (running_) {
+        if (!chain_latency_statistic_) {
+          chain_latency_statistic_ =
+              StatisticsManager::get()->getContinuousStatHandle(CHAIN_LATENCY);
+        }
+        chain_latency_statistic_->addValue((nowNs() - chain_start) / 1000.0);
+      }
+      finishRequest();
+      return;
+    }
+    auto retained = folly::makeMoveWrapper(retainForFollowUp(*next));
+    send(
+        std::move(next),
+        nowNs(),
+        conn_idx,
+        traced,
+        [this, retained, chain_start, conn_idx, traced](
+            folly::Try<typename Service::Reply>&& t) mutable {
+          continueChain(std::move(*retained), t, chain_start, conn_idx, traced);
+        });
+  }
+
+  // Frees the outstanding slot of a request, and of its follow-ups if any
+  void finishRequest() {
+    --outstanding_requests_;
+    interval_statistic_->setOutstanding(outstanding_requests_);
+    setWorkerCounter(kOutstandingRequestsCounter, outstanding_requests_);
+  }
+
+  /**
+   * @param intended_time When the scheduler wanted the request sent
+   */
+  void sendRequest(int64_t intended_time) {
+    bool traced = trace_writer_ && trace_writer_->shouldSample();
     if (outstanding_requests_ < max_outstanding_requests_ && running_) {
+      int64_t get_start_time = get_next_request_statistic_ ? nowNs() : 0;
       auto request_tuple = workload_.getNextRequest();
+      if (get_next_request_statistic_) {
+        get_next_request_statistic_->addValue(nowNs() - get_start_time);
+      }
       if (std::get<0>(request_tuple) == nullptr) {
         LOG(INFO) << "terminating";
         running_.store(false);
@@ -226,57 +491,54 @@ class Worker : private folly::NotificationQueue<Event>::Consumer {
         return;
       }
       auto pw = folly::makeMoveWrapper(std::move(std::get<1>(request_tuple)));
+      auto& request = std::get<0>(request_tuple);
       ++outstanding_requests_;
       auto conn_idx = conn_idx_;
       conn_idx_ = (conn_idx_ + 1) % number_of_connections_;
-      auto send_time = nowNs();
-
-      auto reply =
-          connections_[conn_idx]
-              ->sendRequest(std::move(std::get<0>(request_tuple)))
-              .thenTry([send_time, this, pw](
-                           folly::Try<typename Service::Reply>&& t) mutable {
-                auto recv_time = nowNs();
-                if (running_) {
-                  // If the worker is not in running state, latency stat have
-                  // already been released
-                  latency_statistic_->addValue(
-                      (recv_time - send_time) / 1000.0);
-                }
-                n_throughput_requests_++;
-                if (t.hasException()) {
-                  n_exceptions_by_type_
-                      [t.exception().class_name().toStdString()]++;
-                  LOG(INFO) << t.exception().what();
-                  pw->setException(t.exception());
-                }
-                if (t.hasValue()) {
-                  pw->setValue(std::move(t.value()));
-                }
-
-                --outstanding_requests_;
-                this->setWorkerCounter(
-                    kOutstandingRequestsCounter, outstanding_requests_);
-              });
+      auto head = folly::makeMoveWrapper(retainForFollowUp(*request));
+      auto chain_start = nowNs();
+
+      send(
+          std::move(request),
+          intended_time,
+          conn_idx,
+          traced,
+          [this, pw, head, chain_start, conn_idx, traced](
+              folly::Try<typename Service::Reply>&& t) mutable {
+            if (*head) {
+              // Before the reply is handed over to the workload's promise
+              continueChain(std::move(*head), t, chain_start, conn_idx, traced);
+            } else {
+              finishRequest();
+            }
+            if (t.hasException()) {
+              pw->setException(t.exception());
+            } else {
+              pw->setValue(std::move(t.value()));
+            }
+          });
       auto& f = std::get<2>(request_tuple);
       std::move(f).thenError([this](folly::exception_wrapper ew) {
         n_uncaught_exceptions_by_type_[ew.class_name().toStdString()]++;
         return folly::makeFuture<
             typename std::remove_reference<decltype(f)>::type::value_type>(ew);
       });
-    }
-
-    // Estimate throughput and outstanding requests
-    auto t = nowNs();
-    double throughput_delta = double(t - last_throughput_time_) / k_ns_per_s;
-    if (throughput_delta >= 0.1) {
-      double throughput =
-          n_throughput_requests_ / throughput_delta * number_of_workers_;
-      throughput_statistic_->addValue(throughput);
-      n_throughput_requests_ = 0;
-      last_throughput_time_ = t;
-      double outstanding = outstanding_requests_ * number_of_workers_;
-      outstanding_statistic_->addValue(outstanding);
+      interval_statistic_->setOutstanding(outstanding_requests_);
+    } else if (running_) {
+      workload_.dropRequest();
+      interval_statistic_->addDropped();
+      if (traced) {
+        trace_writer_->record(
+            {intended_time,
+             0,
+             0,
+             0,
+             0,
+             uint16_t(worker_id_),
+             0,
+             TraceStatus::DROPPED,
+             {}});
+      }
     }
 
     for (auto p : n_exceptions_by_type_) {
@@ -301,8 +563,6 @@ class Worker : private folly::NotificationQueue<Event>::Consumer {
   int32_t max_outstanding_requests_;
   Workload<Service> workload_;
   int cpu_affinity_;
-  int64_t last_throughput_time_{0};
-  std::atomic<int64_t> n_throughput_requests_{0};
   std::unordered_map<std::string, size_t> n_exceptions_by_type_;
   std::unordered_map<std::string, size_t> n_uncaught_exceptions_by_type_;
 
@@ -311,12 +571,36 @@ class Worker : private folly::NotificationQueue<Event>::Consumer {
   size_t conn_idx_{0};
   std::atomic<int64_t> outstanding_requests_{0};
   std::shared_ptr<StatisticsManager::Histogram> latency_statistic_{nullptr};
-  std::shared_ptr<StatisticsManager::Histogram> outstanding_statistic_{nullptr};
-  std::shared_ptr<StatisticsManager::Histogram> throughput_statistic_{nullptr};
   std::shared_ptr<StatisticsManager::Counter> exceptions_statistic_{nullptr};
   std::shared_ptr<StatisticsManager::Counter> uncaught_exceptions_statistic_{
       nullptr};
+  WorkerIntervalStatistics* interval_statistic_{nullptr};
+  // Only set with --trace_dir
+  std::unique_ptr<RequestTraceWriter> trace_writer_;
+  // Only set with --client_overhead_stats
+  StatisticsManager::Histogram* queue_wait_statistic_{nullptr};
+  StatisticsManager::Histogram* get_next_request_statistic_{nullptr};
+  StatisticsManager::Histogram* send_request_statistic_{nullptr};
+  // Looked up once the first chain ends
+  StatisticsManager::Histogram* chain_latency_statistic_{nullptr};
+  std::unique_ptr<LoopLagProbe> loop_lag_probe_;
+
+  // Statistics of each operation label, indexed by Request::getOperation()
+  struct OperationStatistics {
+    StatisticsManager::Histogram* latency;
+    StatisticsManager::Counter* requests;
+    StatisticsManager::Counter* errors;
+  };
+  std::vector<OperationStatistics> operation_statistics_;
   std::function<void()> terminate_early_fn_;
+  // Read-only data the workload shares with other workers
+  std::shared_ptr<const typename Workload<Service>::SharedState> shared_state_;
+
+  // Only touched on the worker's thread
+  folly::Promise<PrefillStats> prefill_promise_;
+  PrefillStats prefill_stats_;
+  int32_t prefill_outstanding_{0};
+  bool prefill_done_{false};
 };
 
 } // namespace treadmill
@@ -10,6 +10,17 @@
 
 #pragma once
 
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <folly/dynamic.h>
+
+#include "treadmill/ReplayTrace.h"
+
 namespace facebook {
 namespace windtunnel {
 namespace treadmill {
@@ -17,15 +28,108 @@ namespace treadmill {
 template <class Workload>
 class WorkloadBase {
  public:
+  /**
+   * Read-only data that the workloads of all workers share, such as key
+   * tables, value buffers or an index into a trace, instead of each building
+   * its own copy. Workloads with such data shadow this type, deriving from
+   * it, along with makeSharedState() and setSharedState().
+   */
+  struct SharedState {
+    // With --replay_trace, set by workloads that replay it, so that the
+    // scheduler paces the arrivals from the same mapping.
+    std::shared_ptr<const ReplayTrace> replay_trace;
+  };
+  /**
+   * Builds the shared state from the workload config. The runner calls this
+   * once before creating the workers, or once per NUMA node with
+   * --numa_replicate_shared_state, on a thread pinned to that node so that
+   * the memory is allocated there.
+   */
+  static std::shared_ptr<const SharedState> makeSharedState(
+      const folly::dynamic& /*config*/) {
+    return nullptr;
+  }
+  /**
+   * Called by the worker that owns the workload before it starts, with the
+   * shared state for the worker's NUMA node.
+   */
+  void setSharedState(std::shared_ptr<const SharedState> /*state*/) {}
   void setPhase(const std::string& phase) {
     phase_ = phase;
   }
   const std::string getPhase() const {
     return phase_;
   }
+  /**
+   * Called by the worker that owns the workload before it starts, for
+   * workloads that split their requests between workers.
+   */
+  void setWorker(int worker_id, int number_of_workers) {
+    worker_id_ = worker_id;
+    number_of_workers_ = number_of_workers;
+  }
+  /**
+   * Called by the worker that owns the workload before it starts, with a
+   * seed of the worker's own derived from the master seed. Workloads that
+   * draw from engines of their own seed them from it, so that runs with the
+   * same --treadmill_random_seed send the same requests.
+   */
+  void seed(uint64_t /*seed*/) {}
+  /**
+   * Labels of the operations the workload issues. Request::getOperation()
+   * indexes into this list; workloads with more than one kind of request
+   * shadow this to get separate statistics for each.
+   */
+  std::vector<std::string> getOperationLabels() const {
+    return {"default"};
+  }
+  /**
+   * Called instead of getNextRequest() when the worker drops a request the
+   * scheduler asked for, because it's at its outstanding request limit.
+   * Workloads whose requests are tied to arrival times, like replays, skip
+   * the request that was due.
+   */
+  void dropRequest() {}
+  /**
+   * Whether the reply to request may call for a follow-up. The worker keeps
+   * a copy of such requests until they're answered, to pass to
+   * getFollowUpRequest().
+   */
+  template <class Request>
+  bool mayFollowUp(const Request& /*request*/) const {
+    return false;
+  }
+  /**
+   * The request a client would send next, having got reply to request, as
+   * part of the same operation, e.g. a set after a get that missed; or
+   * nullptr to end the chain. Follow-ups are sent as soon as the reply is
+   * in, without waiting for the scheduler, and the whole chain counts as the
+   * one request the scheduler asked for.
+   */
+  template <class Request, class Reply>
+  std::unique_ptr<Request> getFollowUpRequest(
+      const Request& /*request*/,
+      const Reply& /*reply*/) {
+    return nullptr;
+  }
+  /**
+   * Next request of the prefill stage, which loads the data the workload
+   * expects to find before anything is measured, or a null request once
+   * there are no more. Workers prefill in parallel, so workloads that shadow
+   * this should only return their worker's share. By default there's
+   * nothing to load.
+   */
+  auto getNextPrefillRequest() {
+    using Next = decltype(std::declval<Workload&>().getNextRequest());
+    typename std::tuple_element<1, Next>::type promise;
+    auto future = promise.getFuture();
+    return Next(nullptr, std::move(promise), std::move(future));
+  }
 
  protected:
   std::string phase_;
+  int worker_id_{0};
+  int number_of_workers_{1};
 };
 
 template <class Service>
@@ -46,6 +150,20 @@ class Workload {
    *            > getNextRequest() - to get one request from the workload.
    *  folly::dynamic makeConfigOutputs(
    *      std::vector<Workload<HhvmHttpReplayService>*>)
+   *
+   * and may shadow the following from WorkloadBase:
+   *  std::vector<std::string> getOperationLabels() const - names of the
+   *                 operations, indexed by Request::getOperation().
+   *  void setWorker(int worker_id, int number_of_workers) - to learn which
+   *                 share of the requests is theirs.
+   *  std::tuple<...> getNextPrefillRequest() - to load data before the
+   *                 measured load starts.
+   *  void seed(uint64_t seed) - to seed their random engines.
+   *  void dropRequest() - to skip requests that were due but dropped.
+   *  mayFollowUp() and getFollowUpRequest() - to send requests that depend
+   *                 on the reply to another.
+   *  SharedState, makeSharedState() and setSharedState() - to share
+   *                 read-only data between workers.
    */
 };
 
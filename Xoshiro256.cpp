@@ -0,0 +1,90 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include "treadmill/Xoshiro256.h"
+
+#include <cmath>
+
+namespace facebook {
+namespace windtunnel {
+namespace treadmill {
+
+void Xoshiro256::jump() {
+  static constexpr uint64_t kJump[] = {0x180ec6d33cfd0aba,
+                                       0xd5a61266f0c9392c,
+                                       0xa9582618e03fc9aa,
+                                       0x39abdc4529b1661c};
+  jump(kJump);
+}
+
+void Xoshiro256::longJump() {
+  static constexpr uint64_t kLongJump[] = {0x76e15d3efefdcbbf,
+                                           0xc5004e441c522fb3,
+                                           0x77710069854ee241,
+                                           0x39109bb02acbe635};
+  jump(kLongJump);
+}
+
+void Xoshiro256::jump(const uint64_t (&polynomial)[4]) {
+  uint64_t jumped[4] = {0, 0, 0, 0};
+  for (uint64_t word : polynomial) {
+    for (int bit = 0; bit < 64; bit++) {
+      if (word & (uint64_t(1) << bit)) {
+        for (int i = 0; i < 4; i++) {
+          jumped[i] ^= state_[i];
+        }
+      }
+      (*this)();
+    }
+  }
+  for (int i = 0; i < 4; i++) {
+    state_[i] = jumped[i];
+  }
+}
+
+void Xoshiro256::fill(uint64_t* out, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    out[i] = (*this)();
+  }
+}
+
+void Xoshiro256::fillUniform(double* out, size_t n) {
+  // Draw a cache-resident chunk at a time, then convert it.
+  uint64_t bits[kChunk];
+  for (size_t start = 0; start < n; start += kChunk) {
+    const size_t count = n - start < kChunk ? n - start : kChunk;
+    fill(bits, count);
+    for (size_t i = 0; i < count; i++) {
+      out[start + i] = toUniform(bits[i]);
+    }
+  }
+}
+
+void Xoshiro256::fillExponential(double* out, size_t n, double mean) {
+  fillUniform(out, n);
+  for (size_t i = 0; i < n; i++) {
+    out[i] = -std::log(out[i]) * mean;
+  }
+}
+
+void Xoshiro256::fillInteger(
+    uint64_t* out,
+    size_t n,
+    uint64_t min,
+    uint64_t max) {
+  fill(out, n);
+  for (size_t i = 0; i < n; i++) {
+    out[i] = toInteger(out[i], min, max);
+  }
+}
+
+} // namespace treadmill
+} // namespace windtunnel
+} // namespace facebook
@@ -0,0 +1,131 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace facebook {
+namespace windtunnel {
+namespace treadmill {
+
+/**
+ * xoshiro256** (Blackman and Vigna), a 64 bit generator with 32 bytes of
+ * state that is several times faster than std::mt19937_64 with its 2.5 KB,
+ * and passes BigCrush. It satisfies UniformRandomBitGenerator, so it can
+ * stand in for the standard engines.
+ *
+ * jump() advances the generator by 2^128 draws, which gives up to 2^128
+ * non-overlapping streams from one seed: copy a generator, then jump the
+ * original before handing out the next copy. longJump() advances it by 2^192
+ * draws, to carve out 2^64 such series.
+ */
+class Xoshiro256 {
+ public:
+  using result_type = uint64_t;
+
+  static constexpr result_type min() {
+    return 0;
+  }
+
+  static constexpr result_type max() {
+    return std::numeric_limits<result_type>::max();
+  }
+
+  explicit Xoshiro256(uint64_t seed = 0) {
+    this->seed(seed);
+  }
+
+  // Expand seed into the state with splitmix64, as the authors recommend;
+  // the state can't end up all zero.
+  void seed(uint64_t seed) {
+    for (auto& word : state_) {
+      seed += 0x9e3779b97f4a7c15;
+      uint64_t z = seed;
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+      word = z ^ (z >> 31);
+    }
+  }
+
+  result_type operator()() {
+    const uint64_t result = rotl(state_[1] * 5, 7) * 9;
+    const uint64_t t = state_[1] << 17;
+    state_[2] ^= state_[0];
+    state_[3] ^= state_[1];
+    state_[1] ^= state_[2];
+    state_[0] ^= state_[3];
+    state_[2] ^= t;
+    state_[3] = rotl(state_[3], 45);
+    return result;
+  }
+
+  // Same as 2^128 calls to operator()
+  void jump();
+
+  // Same as 2^192 calls to operator()
+  void longJump();
+
+  /**
+   * Batched generation: scalar code that amortizes the per-call overhead of
+   * drawing one value at a time. The draws are made in one tight loop and
+   * converted in a second one. Every fill consumes exactly n draws, and
+   * out[i] is what the matching scalar conversion of the i-th draw would
+   * give.
+   */
+  void fill(uint64_t* out, size_t n);
+
+  // Uniform in (0, 1)
+  void fillUniform(double* out, size_t n);
+
+  // Exponential with the given mean
+  void fillExponential(double* out, size_t n, double mean);
+
+  // Uniform in [min, max]
+  void fillInteger(uint64_t* out, size_t n, uint64_t min, uint64_t max);
+
+  /**
+   * Uniform in (0, 1), never 0 so that it's safe to take the log of. Uses the
+   * top 53 bits of the draw.
+   */
+  static double toUniform(uint64_t x) {
+    return ((x >> 11) + 0.5) * 0x1.0p-53;
+  }
+
+  /**
+   * Uniform in [min, max] by Lemire's multiply-shift. Skips the rejection
+   * step: the bias is below (max - min) / 2^64, far under anything a
+   * benchmark can observe.
+   */
+  static uint64_t toInteger(uint64_t x, uint64_t min, uint64_t max) {
+    const uint64_t range = max - min + 1;
+    if (range == 0) {
+      return x;
+    }
+    return min + uint64_t((unsigned __int128)x * range >> 64);
+  }
+
+ private:
+  static constexpr size_t kChunk = 256;
+
+  void jump(const uint64_t (&polynomial)[4]);
+
+  static uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+  }
+
+  uint64_t state_[4];
+};
+
+} // namespace treadmill
+} // namespace windtunnel
+} // namespace facebook
@@ -37,6 +37,137 @@ struct RateResponse {
   3: optional i32 max_outstanding;
 }
 
+struct HistogramBucket {
+  /**
+   * Inclusive bounds of the bucket, in microseconds
+   */
+  1: required i64 lower_bound;
+  2: required i64 upper_bound;
+  3: required i64 count;
+}
+
+struct LatencyHistogram {
+  1: required i64 count;
+  2: required double avg;
+  3: required i64 min;
+  4: required i64 max;
+
+  /**
+   * The requested quantiles, keyed like "p99.9"
+   */
+  5: required map<string, double> quantiles;
+
+  /**
+   * Every non-empty bucket, in increasing order; only set if requested
+   */
+  6: optional list<HistogramBucket> buckets;
+}
+
+struct WorkerStats {
+  1: required i32 worker_id;
+
+  /**
+   * Totals since the start of the run
+   */
+  2: required i64 completed;
+  3: required i64 dropped;
+  4: required i64 errors;
+
+  /**
+   * Requests in flight at the end of the last interval
+   */
+  5: required i64 outstanding;
+
+  /**
+   * Requests sent since the start of the run
+   */
+  6: i64 sent;
+}
+
+struct SlowRequestInfo {
+  /**
+   * Latency in microseconds
+   */
+  1: required double latency;
+  2: required i64 send_time_ns;
+
+  /**
+   * Truncated to 64 bytes
+   */
+  3: required binary key;
+  4: required i32 worker;
+  5: required i32 connection;
+
+  /**
+   * Index into the workload's operation labels
+   */
+  6: required i32 operation;
+  7: required bool error;
+}
+
+struct IntervalStats {
+  /**
+   * Number of the first interval covered; consecutive polls can use it to
+   * tell whether they missed intervals
+   */
+  1: required i64 sequence;
+  2: required double elapsed_s;
+  3: required double interval_s;
+  4: required i64 completed;
+  5: required i64 dropped;
+  6: required i64 errors;
+  7: required i64 outstanding;
+  8: required double throughput;
+  9: required LatencyHistogram latency;
+
+  /**
+   * Slowest requests of the covered intervals, slowest first
+   */
+  10: list<SlowRequestInfo> slow_requests;
+
+  /**
+   * Requests sent, and the rates per second of requests sent, succeeded and
+   * failed; throughput is the rate of completed requests
+   */
+  11: i64 sent;
+  12: double sent_rate;
+  13: double success_rate;
+  14: double error_rate;
+}
+
+struct LiveStatsRequest {
+  /**
+   * Quantiles to compute, in [0, 1]
+   */
+  1: list<double> quantiles = [0.5, 0.9, 0.99, 0.999];
+  2: bool include_buckets = false;
+
+  /**
+   * Number of most recent intervals merged into the window
+   */
+  3: i32 window_intervals = 10;
+}
+
+struct LiveStatsResponse {
+  /**
+   * Whether any interval has completed yet; everything else is empty if not
+   */
+  1: required bool available;
+  2: optional IntervalStats last_interval;
+  3: optional IntervalStats window;
+
+  /**
+   * Latency over the whole run so far
+   */
+  4: optional LatencyHistogram cumulative_latency;
+  5: list<WorkerStats> workers;
+
+  /**
+   * Slowest requests of the whole run so far, slowest first
+   */
+  6: list<SlowRequestInfo> slowest_requests;
+}
+
 service TreadmillService extends fb303.FacebookService {
   bool pause();
   bool resume();
@@ -48,6 +179,12 @@ service TreadmillService extends fb303.FacebookService {
   void setMaxOutstanding(1: i32 max_outstanding);
   RateResponse getRate();
 
+  /**
+   * Statistics of the most recent intervals, served from snapshots taken
+   * every --interval_stats_period_ms
+   */
+  LiveStatsResponse getLiveStats(1: LiveStatsRequest req);
+
   string getConfiguration(1: string key);
   void setConfiguration(1: string key, 2: string value);
   void clearConfiguration();
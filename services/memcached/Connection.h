@@ -10,12 +10,18 @@
 
 #pragma once
 
+#include <algorithm>
+#include <functional>
+#include <vector>
+
 #include <folly/MoveWrapper.h>
 #include <folly/fibers/EventBaseLoopController.h>
 #include <folly/fibers/FiberManager.h>
+#include <folly/fibers/WhenN.h>
 #include <folly/futures/Future.h>
 #include <folly/io/IOBuf.h>
 #include <folly/io/async/EventBase.h>
+#include <mcrouter/lib/McResUtil.h>
 #include <mcrouter/lib/network/AsyncMcClient.h>
 #include <mcrouter/lib/network/gen/Memcache.h>
 
@@ -29,6 +35,7 @@ DECLARE_int32(port);
 
 using facebook::memcache::AsyncMcClient;
 using facebook::memcache::ConnectionOptions;
+using facebook::memcache::isHitResult;
 using facebook::memcache::McDeleteRequest;
 using facebook::memcache::McGetRequest;
 using facebook::memcache::McSetRequest;
@@ -42,7 +49,12 @@ namespace treadmill {
 template <>
 class Connection<MemcachedService> {
  public:
-  explicit Connection<MemcachedService>(folly::EventBase& event_base) {
+  explicit Connection<MemcachedService>(folly::EventBase& event_base)
+      : pipelined_get_key_latency_(
+            StatisticsManager::get()->getContinuousStatHandle(
+                "memcached.pipelined_get_key_latency")),
+        pipelined_get_hits_(StatisticsManager::get()->getContinuousStatHandle(
+            "memcached.pipelined_get_hits")) {
     std::string host = nsLookUp(FLAGS_hostname);
     ConnectionOptions opts(host, FLAGS_port, mc_ascii_protocol);
     client_ = std::make_unique<AsyncMcClient>(event_base, opts);
@@ -60,22 +72,28 @@ class Connection<MemcachedService> {
     folly::MoveWrapper<folly::Promise<MemcachedService::Reply>> p;
     auto f = p->getFuture();
 
+    // Keys are cloned, not copied: they share the memory of the request's.
     if (request->which() == MemcachedRequest::GET) {
-      auto req = std::make_shared<McGetRequest>(request->key());
+      auto req =
+          std::make_shared<McGetRequest>(request->key().cloneAsValue());
       fm_->addTask([this, req, p]() mutable {
-        client_->sendSync(*req, std::chrono::milliseconds::zero());
-        p->setValue(MemcachedService::Reply());
+        auto reply = client_->sendSync(*req, std::chrono::milliseconds::zero());
+        p->setValue(MemcachedService::Reply(1, isHitResult(reply.result())));
       });
+    } else if (request->which() == MemcachedRequest::PIPELINED_GET) {
+      sendPipelinedGet(*request, std::move(p));
     } else if (request->which() == MemcachedRequest::SET) {
-      auto req = std::make_shared<McSetRequest>(request->key());
-      req->value_ref() =
-          folly::IOBuf(folly::IOBuf::COPY_BUFFER, request->value());
+      auto req =
+          std::make_shared<McSetRequest>(request->key().cloneAsValue());
+      // Moved, not copied: values from the ValuePool stay zero-copy.
+      req->value_ref() = request->takeValue();
       fm_->addTask([this, req, p]() mutable {
         client_->sendSync(*req, std::chrono::milliseconds::zero());
         p->setValue(MemcachedService::Reply());
       });
     } else {
-      auto req = std::make_shared<McDeleteRequest>(request->key());
+      auto req =
+          std::make_shared<McDeleteRequest>(request->key().cloneAsValue());
       fm_->addTask([this, req, p]() mutable {
         client_->sendSync(*req, std::chrono::milliseconds::zero());
         p->setValue(MemcachedService::Reply());
@@ -85,6 +103,44 @@ class Connection<MemcachedService> {
   }
 
  private:
+  /**
+   * Sends one get per key, all at once, so that the client pipelines them on
+   * the connection, and replies when the last one is back. This isn't a
+   * multi-key get on the wire: AsyncMcClient only has single-key gets, the
+   * same as mcrouter sends servers after splitting a client's multiget. The
+   * batch latency is that of the request; the latency of every key and the
+   * hits of every batch are recorded here.
+   */
+  void sendPipelinedGet(
+      MemcachedRequest& request,
+      folly::MoveWrapper<folly::Promise<MemcachedService::Reply>> p) {
+    auto reqs = std::make_shared<std::vector<McGetRequest>>();
+    reqs->reserve(request.getNumberOfKeys());
+    reqs->emplace_back(request.key().cloneAsValue());
+    for (const auto& key : request.moreKeys()) {
+      reqs->emplace_back(key.cloneAsValue());
+    }
+    fm_->addTask([this, reqs, p]() mutable {
+      std::vector<std::function<bool()>> gets;
+      gets.reserve(reqs->size());
+      for (auto& req : *reqs) {
+        gets.push_back([this, &req] {
+          auto send_time = nowNs();
+          auto reply =
+              client_->sendSync(req, std::chrono::milliseconds::zero());
+          pipelined_get_key_latency_->addValue((nowNs() - send_time) / 1000.0);
+          return isHitResult(reply.result());
+        });
+      }
+      auto found = folly::fibers::collectAll(gets.begin(), gets.end());
+      uint32_t hits = std::count(found.begin(), found.end(), true);
+      pipelined_get_hits_->addValue(hits);
+      p->setValue(MemcachedService::Reply(reqs->size(), hits));
+    });
+  }
+
+  StatisticsManager::Histogram* pipelined_get_key_latency_;
+  StatisticsManager::Histogram* pipelined_get_hits_;
   std::unique_ptr<AsyncMcClient> client_;
   std::unique_ptr<FiberManager> fm_;
 };
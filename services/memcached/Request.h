@@ -10,7 +10,11 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <vector>
+
+#include <folly/io/IOBuf.h>
 
 #include "treadmill/Request.h"
 
@@ -20,14 +24,37 @@ namespace treadmill {
 
 class Request;
 
-class MemcachedReply {};
+/**
+ * What came back: for gets and pipelined gets, how many of the keys asked for
+ * were found.
+ */
+class MemcachedReply {
+ public:
+  MemcachedReply() {}
+  MemcachedReply(uint32_t keys, uint32_t hits) : keys_(keys), hits_(hits) {}
+
+  uint32_t getNumberOfKeys() const {
+    return keys_;
+  }
+
+  uint32_t getHits() const {
+    return hits_;
+  }
+
+ private:
+  uint32_t keys_{0};
+  uint32_t hits_{0};
+};
 
 class MemcachedRequest : public Request {
  public:
-  enum Operation { GET, SET, DELETE };
+  enum Operation { GET, SET, DELETE, PIPELINED_GET };
 
-  MemcachedRequest(Operation type, std::string key)
-      : type_(type), key_(std::move(key)) {}
+  // The key may share memory it doesn't own, e.g. from a KeyFormatter.
+  MemcachedRequest(Operation type, folly::IOBuf key)
+      : type_(type), key_(std::move(key)) {
+    setOperation(type);
+  }
 
   virtual ~MemcachedRequest() {}
 
@@ -35,26 +62,60 @@ class MemcachedRequest : public Request {
     return "MemcachedRequest";
   }
 
-  Operation which() {
+  Operation which() const {
     return type_;
   }
 
-  void setValue(const std::string value) {
-    value_ = value;
+  void setValue(const std::string& value) {
+    setValue(folly::IOBuf(folly::IOBuf::COPY_BUFFER, value));
+  }
+
+  // The value may wrap memory it doesn't own, e.g. from a ValuePool.
+  void setValue(folly::IOBuf value) {
+    value_ = std::move(value);
+    setPayloadSize(value_.computeChainDataLength());
   }
 
-  const std::string& key() const {
+  const folly::IOBuf& key() const {
     return key_;
   }
 
-  const std::string& value() const {
+  // For pipelined gets: keys after the first one
+  void addKey(folly::IOBuf key) {
+    more_keys_.push_back(std::move(key));
+  }
+
+  const std::vector<folly::IOBuf>& moreKeys() const {
+    return more_keys_;
+  }
+
+  size_t getNumberOfKeys() const {
+    return 1 + more_keys_.size();
+  }
+
+  folly::StringPiece getKey() const override {
+    return folly::StringPiece(
+        reinterpret_cast<const char*>(key_.data()), key_.length());
+  }
+
+  // A reference count increment, not a copy
+  folly::IOBuf shareKey() const override {
+    return key_.cloneAsValue();
+  }
+
+  const folly::IOBuf& value() const {
     return value_;
   }
 
+  folly::IOBuf takeValue() {
+    return std::move(value_);
+  }
+
  private:
   Operation type_;
-  std::string key_;
-  std::string value_;
+  folly::IOBuf key_;
+  std::vector<folly::IOBuf> more_keys_;
+  folly::IOBuf value_;
 };
 
 } // namespace treadmill
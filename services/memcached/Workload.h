@@ -10,13 +10,26 @@
 
 #pragma once
 
+#include <algorithm>
+#include <map>
+#include <memory>
 #include <vector>
 
 #include "treadmill/services/memcached/MemcachedService.h"
 
+#include "treadmill/AliasTable.h"
+#include "treadmill/KeyChooser.h"
+#include "treadmill/KeyFormatter.h"
+#include "treadmill/RandomEngine.h"
+#include "treadmill/ReplayTrace.h"
+#include "treadmill/SizeDistribution.h"
+#include "treadmill/StatisticsManager.h"
+#include "treadmill/ValuePool.h"
 #include "treadmill/Workload.h"
+#include "treadmill/Xoshiro256.h"
 
 DECLARE_int64(number_of_keys);
+DECLARE_string(replay_trace);
 
 using folly::Future;
 using folly::Promise;
@@ -29,13 +42,144 @@ template <>
 class Workload<MemcachedService>
     : public WorkloadBase<Workload<MemcachedService>> {
  public:
-  enum State { WARMUP, GET };
+  enum State { RUN, REPLAY };
 
-  Workload<MemcachedService>(folly::dynamic /*config*/)
-      : state_(State::WARMUP), index_(0) {}
+  /**
+   * Prefills by setting every key once, each worker its share of the
+   * keyspace, then sends a mix of operations to keys picked according to
+   * config["key_distribution"]; see KeyChooser::make(). Keys are formatted
+   * as config["key_format"] says; see KeyFormatter. The sizes of the values
+   * set follow config["value_size"]; see SizeDistribution::make(). Set
+   * config["prefill"] to false to skip the prefill.
+   *
+   * The mix gives the relative weight of each operation, e.g.
+   *   "operation_mix": {"get": 80, "pipelined_get": 10, "set": 9, "delete": 1}
+   * and is all gets by default. The number of keys of a pipelined get follows
+   * config["pipelined_get_size"], another SizeDistribution, 10 by default.
+   * Phases can have mixes of their own:
+   *   "phase_operation_mix": {"write_heavy": {"get": 1, "set": 1}}
+   * Phases without one use operation_mix.
+   *
+   * With config["read_through"], a get that misses is followed by a set of
+   * its key, the way a read-through cache client refills the cache. Then
+   * chain_latency covers both, and the mean of memcached.read_through_hits
+   * is the hit ratio of the gets.
+   *
+   * With --replay_trace, there's no prefill: worker i of n replays requests
+   * i, i + n, i + 2n, ... of the trace instead, with operations labelled as
+   * in getOperationLabels(), and stops at the end of its share. Records
+   * due while the worker is at its outstanding request limit are dropped,
+   * so that every record sent keeps its own time.
+   */
+  Workload<MemcachedService>(folly::dynamic config)
+      : state_(State::RUN),
+        prefill_(config.getDefault("prefill", true).asBool()),
+        read_through_(config.getDefault("read_through", false).asBool()),
+        seed_(0),
+        engine_(seed_),
+        default_mix_(makeOperationMix(config.getDefault(
+            "operation_mix", folly::dynamic::object("get", 1)))),
+        mix_(&default_mix_),
+        key_chooser_(KeyChooser::make(
+            config.getDefault("key_distribution", folly::dynamic::object),
+            FLAGS_number_of_keys,
+            0)),
+        key_formatter_(
+            config.getDefault("key_format", folly::dynamic::object),
+            FLAGS_number_of_keys),
+        value_sizes_(SizeDistribution::make(
+            config.getDefault("value_size", folly::dynamic::object), 0)),
+        pipelined_get_sizes_(SizeDistribution::make(
+            config.getDefault(
+                "pipelined_get_size",
+                folly::dynamic::object("type", "fixed")("size", 10)),
+            0)),
+        read_through_sizes_(SizeDistribution::make(
+            config.getDefault("value_size", folly::dynamic::object), 0)) {
+    for (const auto& phase :
+         config.getDefault("phase_operation_mix", folly::dynamic::object)
+             .items()) {
+      phase_mixes_.emplace(
+          phase.first.asString(), makeOperationMix(phase.second));
+    }
+    if (!FLAGS_replay_trace.empty()) {
+      state_ = State::REPLAY;
+    }
+    if (read_through_) {
+      read_through_hits_ = StatisticsManager::get()->getContinuousStatHandle(
+          "memcached.read_through_hits");
+    }
+  }
+
+  /**
+   * What workers only read: the replay trace, the precomputed keys and the
+   * value pool. One copy serves every worker, or every worker of a NUMA node.
+   */
+  struct SharedState : WorkloadBase::SharedState {
+    std::shared_ptr<const KeyArena> key_arena;
+    std::shared_ptr<const ValuePool> value_pool;
+  };
+
+  static std::shared_ptr<const SharedState> makeSharedState(
+      const folly::dynamic& config) {
+    auto state = std::make_shared<SharedState>();
+    size_t max_value_size;
+    if (!FLAGS_replay_trace.empty()) {
+      state->replay_trace = std::make_shared<ReplayTrace>(FLAGS_replay_trace);
+      max_value_size = state->replay_trace->header().max_value_size;
+    } else {
+      state->key_arena = KeyFormatter::makeArena(
+          config.getDefault("key_format", folly::dynamic::object),
+          FLAGS_number_of_keys);
+      max_value_size =
+          SizeDistribution::make(
+              config.getDefault("value_size", folly::dynamic::object), 0)
+              ->getMaxSize();
+    }
+    state->value_pool = std::make_shared<const ValuePool>(max_value_size);
+    return state;
+  }
+
+  void setSharedState(std::shared_ptr<const SharedState> state) {
+    replay_trace_ = state->replay_trace;
+    key_formatter_.setArena(state->key_arena);
+    value_pool_ = state->value_pool;
+  }
 
   void reset() {
-    index_ = 0;
+    replayed_ = 0;
+    read_through_sets_ = 0;
+    engine_.seed(seed_);
+    key_chooser_->reset();
+    value_sizes_->reset();
+    pipelined_get_sizes_->reset();
+    read_through_sizes_->reset();
+  }
+
+  // Every random choice has a stream of its own, so that e.g. changing the
+  // operation mix doesn't change which keys are picked.
+  void seed(uint64_t seed) {
+    seed_ = RandomEngine::deriveSeed(seed, 0);
+    engine_.seed(seed_);
+    key_chooser_->seed(RandomEngine::deriveSeed(seed, 1));
+    value_sizes_->seed(RandomEngine::deriveSeed(seed, 2));
+    pipelined_get_sizes_->seed(RandomEngine::deriveSeed(seed, 3));
+    read_through_sizes_->seed(RandomEngine::deriveSeed(seed, 4));
+  }
+
+  void setWorker(int worker_id, int number_of_workers) {
+    WorkloadBase::setWorker(worker_id, number_of_workers);
+    if (prefill_ && state_ != State::REPLAY) {
+      uint64_t number_of_keys = FLAGS_number_of_keys;
+      prefill_next_ = number_of_keys * worker_id / number_of_workers;
+      prefill_end_ = number_of_keys * (worker_id + 1) / number_of_workers;
+    }
+  }
+
+  void setPhase(const std::string& phase) {
+    WorkloadBase::setPhase(phase);
+    auto it = phase_mixes_.find(phase);
+    mix_ = it != phase_mixes_.end() ? &it->second : &default_mix_;
   }
 
   std::tuple<
@@ -43,39 +187,173 @@ class Workload<MemcachedService>
       Promise<MemcachedService::Reply>,
       Future<MemcachedService::Reply>>
   getNextRequest() {
-    if (index_ == FLAGS_number_of_keys) {
-      index_ = 0;
+    std::unique_ptr<MemcachedService::Request> request;
+    if (state_ == State::REPLAY) {
+      uint64_t i = worker_id_ + replayed_ * number_of_workers_;
+      if (i < replay_trace_->size()) {
+        request = makeReplayRequest(i);
+        ++replayed_;
+      }
+    } else {
+      auto operation = MemcachedRequest::Operation((*mix_)(engine_));
+      auto key = key_chooser_->next();
+      if (operation == MemcachedRequest::SET) {
+        request = makeSet(key);
+      } else if (operation == MemcachedRequest::PIPELINED_GET) {
+        request = makePipelinedGet(key);
+      } else {
+        request = std::make_unique<MemcachedRequest>(
+            operation, key_formatter_.format(key));
+      }
     }
+    Promise<MemcachedService::Reply> p;
+    auto f = p.getFuture();
+    return std::make_tuple(std::move(request), std::move(p), std::move(f));
+  }
 
-    std::string key = std::to_string(index_);
+  // A replayed record is tied to its time slot: skip the one that was due.
+  void dropRequest() {
+    if (state_ == State::REPLAY) {
+      ++replayed_;
+    }
+  }
 
+  // Sets this worker's share of the keys, each once
+  std::tuple<
+      std::unique_ptr<MemcachedService::Request>,
+      Promise<MemcachedService::Reply>,
+      Future<MemcachedService::Reply>>
+  getNextPrefillRequest() {
     std::unique_ptr<MemcachedService::Request> request;
-    if (state_ == State::WARMUP) {
-      request = std::make_unique<MemcachedRequest>(
-          MemcachedRequest::SET, std::move(key));
-      request->setValue(std::to_string(index_));
-      if (index_ == FLAGS_number_of_keys - 1) {
-        LOG(INFO) << "WARMUP complete";
-        state_ = State::GET;
-      }
-    } else if (state_ == State::GET) {
-      request = std::make_unique<MemcachedRequest>(
-          MemcachedRequest::GET, std::move(key));
+    if (prefill_next_ < prefill_end_) {
+      request = makeSet(prefill_next_++);
     }
     Promise<MemcachedService::Reply> p;
     auto f = p.getFuture();
-    ++index_;
     return std::make_tuple(std::move(request), std::move(p), std::move(f));
   }
 
+  bool mayFollowUp(const MemcachedRequest& request) const {
+    return read_through_ && request.which() == MemcachedRequest::GET;
+  }
+
+  // With read_through, sets the key of a get that missed
+  std::unique_ptr<MemcachedService::Request> getFollowUpRequest(
+      const MemcachedRequest& request,
+      const MemcachedReply& reply) {
+    if (request.which() != MemcachedRequest::GET) {
+      return nullptr;
+    }
+    read_through_hits_->addValue(reply.getHits());
+    if (reply.getHits() > 0) {
+      return nullptr;
+    }
+    auto set = std::make_unique<MemcachedRequest>(
+        MemcachedRequest::SET, request.key().cloneAsValue());
+    set->setValue(
+        value_pool_->wrap(read_through_sizes_->next(), read_through_sets_));
+    ++read_through_sets_;
+    return set;
+  }
+
+  // Indexed by MemcachedRequest::Operation
+  std::vector<std::string> getOperationLabels() const {
+    return {"get", "set", "delete", "pipelined_get"};
+  }
+
   folly::dynamic makeConfigOutputs(
       std::vector<Workload<MemcachedService>*> /*workloads*/) {
     return folly::dynamic::object;
   }
 
  private:
+  // Weights of the operations in MemcachedRequest::Operation order
+  static AliasTable makeOperationMix(const folly::dynamic& mix) {
+    const auto labels =
+        std::vector<std::string>{"get", "set", "delete", "pipelined_get"};
+    std::vector<double> weights(labels.size(), 0.0);
+    for (const auto& item : mix.items()) {
+      auto it = std::find(labels.begin(), labels.end(), item.first.asString());
+      if (it == labels.end()) {
+        LOG(FATAL) << "Unknown memcached operation in mix: " << item.first;
+      }
+      weights[it - labels.begin()] = item.second.asDouble();
+    }
+    return AliasTable(weights);
+  }
+
+  std::unique_ptr<MemcachedService::Request> makeSet(uint64_t key) {
+    auto request = std::make_unique<MemcachedRequest>(
+        MemcachedRequest::SET, key_formatter_.format(key));
+    request->setValue(value_pool_->wrap(value_sizes_->next(), key));
+    key_chooser_->recordWrite(key);
+    return request;
+  }
+
+  std::unique_ptr<MemcachedService::Request> makePipelinedGet(uint64_t key) {
+    auto request = std::make_unique<MemcachedRequest>(
+        MemcachedRequest::PIPELINED_GET, key_formatter_.format(key));
+    for (size_t n = pipelined_get_sizes_->next(); n > 1; --n) {
+      request->addKey(key_formatter_.format(key_chooser_->next()));
+    }
+    return request;
+  }
+
+  std::unique_ptr<MemcachedService::Request> makeReplayRequest(uint64_t i) {
+    const auto& record = (*replay_trace_)[i];
+    // Read from the file: a corrupt record mustn't turn into deletes or
+    // reads out of bounds.
+    CHECK_LE(record.operation, MemcachedRequest::DELETE)
+        << "Replay trace record " << i << " has an unknown operation";
+    const uint64_t keys_size = replay_trace_->header().keys_size;
+    CHECK(
+        record.key_offset <= keys_size &&
+        record.key_length <= keys_size - record.key_offset)
+        << "Replay trace record " << i << " has a key out of bounds";
+    CHECK_LE(record.value_size, value_pool_->getMaxSize())
+        << "Replay trace record " << i
+        << " has a value larger than the trace's max_value_size";
+    auto key = replay_trace_->getKey(record);
+    // Straight out of the mapped trace
+    auto request = std::make_unique<MemcachedRequest>(
+        MemcachedRequest::Operation(record.operation),
+        folly::IOBuf(folly::IOBuf::WRAP_BUFFER, key.data(), key.size()));
+    if (record.operation == MemcachedRequest::SET) {
+      request->setValue(value_pool_->wrap(record.value_size, i));
+    }
+    return request;
+  }
+
   State state_;
-  int index_;
+  const bool prefill_;
+  const bool read_through_;
+  // Only with read_through
+  StatisticsManager::Histogram* read_through_hits_{nullptr};
+  // Sets sent after misses, which pick the bytes of their values
+  uint64_t read_through_sets_{0};
+  // Keys of this worker's share left to set during the prefill
+  uint64_t prefill_next_{0};
+  uint64_t prefill_end_{0};
+  // Only with --replay_trace
+  std::shared_ptr<const ReplayTrace> replay_trace_;
+  // Requests of this worker's share replayed or dropped so far
+  uint64_t replayed_{0};
+  // Of the operation mix; set by seed()
+  uint64_t seed_;
+  // Draws the operations
+  Xoshiro256 engine_;
+  const AliasTable default_mix_;
+  std::map<std::string, AliasTable> phase_mixes_;
+  // Mix of the current phase
+  const AliasTable* mix_;
+  std::unique_ptr<KeyChooser> key_chooser_;
+  KeyFormatter key_formatter_;
+  std::unique_ptr<SizeDistribution> value_sizes_;
+  std::unique_ptr<SizeDistribution> pipelined_get_sizes_;
+  // Sizes of the sets after misses, drawn apart from value_sizes_ so that
+  // the server's hits and misses don't shift the sizes of the other sets
+  std::unique_ptr<SizeDistribution> read_through_sizes_;
+  std::shared_ptr<const ValuePool> value_pool_;
 };
 
 } // namespace treadmill
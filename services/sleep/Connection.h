@@ -32,7 +32,8 @@ template <>
 class Connection<SleepService> {
  public:
   Connection<SleepService>(folly::EventBase& event_base)
-      : histo_(StatisticsManager::get()->getContinuousStat("SleepTime")) {
+      : histo_(
+            StatisticsManager::get()->getContinuousStatHandle("SleepTime")) {
     std::string host = nsLookUp(FLAGS_hostname);
     auto socket = folly::AsyncSocket::newSocket(&event_base, host, FLAGS_port);
     auto channel =
@@ -49,7 +50,7 @@ class Connection<SleepService> {
   folly::Future<SleepService::Reply> sendRequest(
       std::unique_ptr<typename SleepService::Request> request) {
     auto f = client_->future_goSleep(request->sleep_time())
-                 .thenTry([histo = histo_](folly::Try<int64_t>&& t) mutable {
+                 .thenTry([histo = histo_](folly::Try<int64_t>&& t) {
                    histo->addValue(t.value());
                    return SleepReply(t.value());
                  });
@@ -57,7 +58,7 @@ class Connection<SleepService> {
   }
 
  private:
-  std::shared_ptr<StatisticsManager::Histogram> histo_;
+  StatisticsManager::Histogram* histo_;
   std::unique_ptr<services::sleep::SleepAsyncClient> client_;
 };
 
@@ -37,7 +37,9 @@ class SleepRequest : public Request {
   enum Operation { SLEEP };
 
   SleepRequest(Operation type, int64_t sleep_time)
-      : type_(type), sleep_time_(sleep_time) {}
+      : type_(type), sleep_time_(sleep_time) {
+    setOperation(type);
+  }
 
   virtual ~SleepRequest() {}
 
@@ -41,6 +41,11 @@ class Workload<SleepService> : public WorkloadBase<Workload<SleepService>> {
     return std::make_tuple(std::move(request), std::move(p), std::move(f));
   }
 
+  // Indexed by SleepRequest::Operation
+  std::vector<std::string> getOperationLabels() const {
+    return {"sleep"};
+  }
+
   folly::dynamic makeConfigOutputs(
       std::vector<Workload<SleepService>*> /*workloads*/) {
     return folly::dynamic::object;
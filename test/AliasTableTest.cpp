@@ -0,0 +1,60 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include "treadmill/AliasTable.h"
+
+#include <numeric>
+#include <vector>
+
+#include "treadmill/Xoshiro256.h"
+
+namespace facebook {
+namespace windtunnel {
+namespace treadmill {
+
+namespace {
+
+TEST(AliasTableTest, Frequencies) {
+  const size_t kNumSamples = 1000000;
+  const std::vector<double> weights = {1, 0, 5, 2, 0.5, 1.5};
+  const double total = std::accumulate(weights.begin(), weights.end(), 0.0);
+  AliasTable table(weights);
+  ASSERT_EQ(weights.size(), table.size());
+  Xoshiro256 engine(0);
+  std::vector<size_t> counts(weights.size(), 0);
+  for (size_t i = 0; i < kNumSamples; i++) {
+    counts[table(engine)]++;
+  }
+  EXPECT_EQ(0, counts[1]);
+  for (size_t i = 0; i < weights.size(); i++) {
+    EXPECT_NEAR(weights[i] / total, double(counts[i]) / kNumSamples, 0.002);
+  }
+}
+
+TEST(AliasTableTest, SingleWeight) {
+  AliasTable table({3});
+  Xoshiro256 engine(0);
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_EQ(0, table(engine));
+  }
+}
+
+} // namespace
+
+} // namespace treadmill
+} // namespace windtunnel
+} // namespace facebook
+
+int main(int argc, char* argv[]) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,90 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <folly/Benchmark.h>
+#include <folly/init/Init.h>
+#include <glog/logging.h>
+
+#include "treadmill/CounterStatistic.h"
+
+using facebook::windtunnel::treadmill::CounterStatistic;
+
+namespace {
+
+// Split iters increments over the given number of threads, all hammering the
+// same counter.
+template <class Fn>
+void runThreads(size_t iters, size_t number_of_threads, Fn fn) {
+  std::vector<std::unique_ptr<std::thread>> threads;
+  for (size_t i = 0; i < number_of_threads; i++) {
+    threads.push_back(std::make_unique<std::thread>(
+        [&fn, n = iters / number_of_threads] {
+          for (size_t j = 0; j < n; j++) {
+            fn();
+          }
+        }));
+  }
+  for (auto& thread : threads) {
+    thread->join();
+  }
+}
+
+// A single shared atomic, i.e. the cheapest race-free unsharded counter.
+void atomicCounter(size_t iters, size_t number_of_threads) {
+  std::atomic<int64_t> count{0};
+  runThreads(iters, number_of_threads, [&count] {
+    count.fetch_add(1, std::memory_order_relaxed);
+  });
+  CHECK_EQ(iters / number_of_threads * number_of_threads, count.load());
+}
+
+void shardedCounter(size_t iters, size_t number_of_threads) {
+  CounterStatistic counter("benchmark");
+  runThreads(iters, number_of_threads, [&counter] { counter.increase(1); });
+  CHECK_EQ(iters / number_of_threads * number_of_threads, counter.getCount());
+}
+
+void shardedCounterWithSubkey(size_t iters, size_t number_of_threads) {
+  CounterStatistic counter("benchmark");
+  const std::string subkey = "subkey";
+  runThreads(iters, number_of_threads, [&counter, &subkey] {
+    counter.increase(1, subkey);
+  });
+  CHECK_EQ(iters / number_of_threads * number_of_threads, counter.getCount());
+}
+
+} // namespace
+
+BENCHMARK_PARAM(atomicCounter, 1);
+BENCHMARK_RELATIVE_PARAM(shardedCounter, 1);
+BENCHMARK_RELATIVE_PARAM(shardedCounterWithSubkey, 1);
+BENCHMARK_DRAW_LINE();
+BENCHMARK_PARAM(atomicCounter, 4);
+BENCHMARK_RELATIVE_PARAM(shardedCounter, 4);
+BENCHMARK_RELATIVE_PARAM(shardedCounterWithSubkey, 4);
+BENCHMARK_DRAW_LINE();
+BENCHMARK_PARAM(atomicCounter, 16);
+BENCHMARK_RELATIVE_PARAM(shardedCounter, 16);
+BENCHMARK_RELATIVE_PARAM(shardedCounterWithSubkey, 16);
+BENCHMARK_DRAW_LINE();
+BENCHMARK_PARAM(atomicCounter, 64);
+BENCHMARK_RELATIVE_PARAM(shardedCounter, 64);
+BENCHMARK_RELATIVE_PARAM(shardedCounterWithSubkey, 64);
+
+int main(int argc, char* argv[]) {
+  folly::init(&argc, &argv);
+  folly::runBenchmarks();
+  return 0;
+}
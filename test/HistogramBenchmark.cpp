@@ -0,0 +1,86 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include <random>
+#include <vector>
+
+#include <folly/Benchmark.h>
+#include <folly/init/Init.h>
+#include <folly/stats/QuantileEstimator.h>
+
+#include "treadmill/Histogram.h"
+
+using facebook::windtunnel::treadmill::Histogram;
+
+namespace {
+
+// Latency-like samples in microseconds, generated up front so the benchmarks
+// only measure the recording cost.
+const std::vector<double>& samples() {
+  static const std::vector<double> values = [] {
+    std::vector<double> v(1 << 16);
+    std::mt19937_64 rng(0);
+    std::lognormal_distribution<double> dist(5.0, 1.0);
+    for (auto& x : v) {
+      x = dist(rng);
+    }
+    return v;
+  }();
+  return values;
+}
+
+} // namespace
+
+BENCHMARK(SimpleQuantileEstimatorAddValue, iters) {
+  folly::SimpleQuantileEstimator<> estimator;
+  const auto& values = samples();
+  for (size_t i = 0; i < iters; i++) {
+    estimator.addValue(values[i & (values.size() - 1)]);
+  }
+}
+
+BENCHMARK_RELATIVE(HistogramAddValue, iters) {
+  Histogram histogram;
+  const auto& values = samples();
+  for (size_t i = 0; i < iters; i++) {
+    histogram.addValue(values[i & (values.size() - 1)]);
+  }
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(SimpleQuantileEstimatorQuantiles, iters) {
+  folly::SimpleQuantileEstimator<> estimator;
+  for (auto x : samples()) {
+    estimator.addValue(x);
+  }
+  std::array<double, 3> quantiles{{0.5, 0.99, 0.999}};
+  for (size_t i = 0; i < iters; i++) {
+    estimator.flush();
+    folly::doNotOptimizeAway(estimator.estimateQuantiles(quantiles));
+  }
+}
+
+BENCHMARK_RELATIVE(HistogramQuantiles, iters) {
+  Histogram histogram;
+  for (auto x : samples()) {
+    histogram.addValue(x);
+  }
+  std::vector<double> quantiles{0.5, 0.99, 0.999};
+  for (size_t i = 0; i < iters; i++) {
+    folly::doNotOptimizeAway(histogram.getQuantiles(quantiles));
+  }
+}
+
+int main(int argc, char* argv[]) {
+  folly::init(&argc, &argv);
+  folly::runBenchmarks();
+  return 0;
+}
@@ -0,0 +1,135 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include "treadmill/Histogram.h"
+
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace facebook {
+namespace windtunnel {
+namespace treadmill {
+
+namespace {
+
+TEST(HistogramTest, BucketBoundaries) {
+  for (int bits = Histogram::kMinSignificantBits;
+       bits <= Histogram::kMaxSignificantBits;
+       bits++) {
+    Histogram histogram(bits);
+    // Buckets are contiguous and cover the whole 64-bit range.
+    uint64_t expected_lower = 0;
+    for (size_t i = 0; i < histogram.getNumberOfBuckets(); i++) {
+      ASSERT_EQ(expected_lower, histogram.bucketLowerBound(i));
+      ASSERT_EQ(i, histogram.bucketIndex(histogram.bucketLowerBound(i)));
+      expected_lower += histogram.bucketWidth(i);
+    }
+    // The last bucket ends exactly at 2^64 - 1, so the sum wrapped to 0.
+    ASSERT_EQ(0, expected_lower);
+    ASSERT_EQ(
+        histogram.getNumberOfBuckets() - 1,
+        histogram.bucketIndex(std::numeric_limits<uint64_t>::max()));
+  }
+}
+
+TEST(HistogramTest, QuantileRelativeError) {
+  const int kBits = 8;
+  const double kRelativeError = std::ldexp(1.0, -(kBits - 1));
+  Histogram histogram(kBits);
+  std::vector<double> values;
+  std::mt19937_64 rng(0);
+  std::lognormal_distribution<double> dist(6.0, 1.5);
+  for (int i = 0; i < 100000; i++) {
+    double x = std::round(dist(rng));
+    values.push_back(x);
+    histogram.addValue(x);
+  }
+  std::sort(values.begin(), values.end());
+
+  ASSERT_EQ(values.size(), histogram.getCount());
+  ASSERT_EQ(values.front(), histogram.getMin());
+  ASSERT_EQ(values.back(), histogram.getMax());
+  for (double q : {0.0, 0.01, 0.5, 0.9, 0.99, 0.999, 1.0}) {
+    size_t rank = std::max<size_t>(1, std::ceil(q * values.size()));
+    double exact = values[rank - 1];
+    ASSERT_NEAR(exact, histogram.getQuantile(q), exact * kRelativeError + 0.5)
+        << "quantile " << q;
+  }
+}
+
+TEST(HistogramTest, MergeIsExact) {
+  Histogram a, b, all;
+  for (int i = 0; i < 10000; i++) {
+    a.addValue(i);
+    all.addValue(i);
+    b.addValue(i * 37);
+    all.addValue(i * 37);
+  }
+  a.merge(b);
+  ASSERT_EQ(all.getCount(), a.getCount());
+  ASSERT_EQ(all.getSum(), a.getSum());
+  ASSERT_EQ(all.getMin(), a.getMin());
+  ASSERT_EQ(all.getMax(), a.getMax());
+  std::vector<double> quantiles = {0.1, 0.5, 0.99};
+  ASSERT_EQ(all.getQuantiles(quantiles), a.getQuantiles(quantiles));
+}
+
+TEST(HistogramTest, DynamicRoundTrip) {
+  Histogram histogram(6);
+  for (int i = 0; i < 10000; i++) {
+    histogram.addValue(i * 13 % 4999);
+  }
+  std::vector<double> quantiles = {0.1, 0.5, 0.99};
+  auto rebuilt = Histogram::fromDynamic(histogram.toDynamic(quantiles));
+  ASSERT_EQ(histogram.getSignificantBits(), rebuilt.getSignificantBits());
+  ASSERT_EQ(histogram.getCount(), rebuilt.getCount());
+  ASSERT_EQ(histogram.getSum(), rebuilt.getSum());
+  ASSERT_EQ(histogram.getMin(), rebuilt.getMin());
+  ASSERT_EQ(histogram.getMax(), rebuilt.getMax());
+  ASSERT_EQ(
+      histogram.getQuantiles(quantiles), rebuilt.getQuantiles(quantiles));
+}
+
+TEST(HistogramTest, ConcurrentAddValue) {
+  const int kNumThreads = 8;
+  const int kNumSamples = 100000;
+  Histogram histogram;
+  std::vector<std::unique_ptr<std::thread>> threads;
+  for (int i = 0; i < kNumThreads; i++) {
+    threads.push_back(std::make_unique<std::thread>([&histogram, i] {
+      for (int j = 0; j < kNumSamples; j++) {
+        histogram.addValue(i * kNumSamples + j);
+      }
+    }));
+  }
+  for (auto& thread : threads) {
+    thread->join();
+  }
+  ASSERT_EQ(kNumThreads * kNumSamples, histogram.getCount());
+  ASSERT_EQ(0, histogram.getMin());
+  ASSERT_EQ(kNumThreads * kNumSamples - 1, histogram.getMax());
+}
+
+} // namespace
+
+} // namespace treadmill
+} // namespace windtunnel
+} // namespace facebook
+
+int main(int argc, char* argv[]) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
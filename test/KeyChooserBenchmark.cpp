@@ -0,0 +1,70 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include <folly/Benchmark.h>
+#include <folly/dynamic.h>
+#include <folly/init/Init.h>
+
+#include "treadmill/KeyChooser.h"
+
+using facebook::windtunnel::treadmill::KeyChooser;
+
+namespace {
+
+// A billion keys, to show that no chooser depends on the size of the key
+// space. Every iteration is one draw, so iters/s is draws per second on one
+// core.
+constexpr uint64_t kNumberOfKeys = 1000000000;
+
+void drawKeys(size_t iters, const folly::dynamic& config) {
+  std::unique_ptr<KeyChooser> chooser;
+  BENCHMARK_SUSPEND {
+    chooser = KeyChooser::make(config, kNumberOfKeys, 0);
+  }
+  for (size_t i = 0; i < iters; i++) {
+    folly::doNotOptimizeAway(chooser->next());
+  }
+}
+
+} // namespace
+
+BENCHMARK(Sequential, iters) {
+  drawKeys(iters, folly::dynamic::object("type", "sequential"));
+}
+
+BENCHMARK_RELATIVE(Uniform, iters) {
+  drawKeys(iters, folly::dynamic::object("type", "uniform"));
+}
+
+BENCHMARK_RELATIVE(Hotspot, iters) {
+  drawKeys(iters, folly::dynamic::object("type", "hotspot"));
+}
+
+BENCHMARK_RELATIVE(Zipf099, iters) {
+  drawKeys(iters, folly::dynamic::object("type", "zipf")("theta", 0.99));
+}
+
+BENCHMARK_RELATIVE(Zipf05, iters) {
+  drawKeys(iters, folly::dynamic::object("type", "zipf")("theta", 0.5));
+}
+
+BENCHMARK_RELATIVE(Zipf15, iters) {
+  drawKeys(iters, folly::dynamic::object("type", "zipf")("theta", 1.5));
+}
+
+BENCHMARK_RELATIVE(Latest, iters) {
+  drawKeys(iters, folly::dynamic::object("type", "latest")("theta", 0.99));
+}
+
+int main(int argc, char* argv[]) {
+  folly::init(&argc, &argv);
+  folly::runBenchmarks();
+  return 0;
+}
@@ -0,0 +1,151 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include "treadmill/KeyChooser.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace facebook {
+namespace windtunnel {
+namespace treadmill {
+
+namespace {
+
+// How often each key comes up in n draws
+std::vector<uint64_t> countKeys(KeyChooser& chooser, size_t n) {
+  std::vector<uint64_t> counts(chooser.getNumberOfKeys(), 0);
+  for (size_t i = 0; i < n; i++) {
+    auto key = chooser.next();
+    EXPECT_LT(key, counts.size());
+    if (key < counts.size()) {
+      counts[key]++;
+    }
+  }
+  return counts;
+}
+
+// The observed frequency of an event of probability p should be within
+// five standard deviations of it
+void expectFrequency(double p, uint64_t count, size_t n) {
+  double sd = std::sqrt(p * (1 - p) / n);
+  EXPECT_NEAR(p, double(count) / n, 5 * sd + 1e-9);
+}
+
+TEST(KeyChooserTest, ZipfRankFrequencies) {
+  const uint64_t kNumberOfRanks = 100;
+  const size_t kNumSamples = 1000000;
+  for (double theta : {0.5, 0.99, 1.0, 1.5}) {
+    SCOPED_TRACE(theta);
+    ZipfDistribution zipf(kNumberOfRanks, theta);
+    Xoshiro256 engine(0);
+    std::vector<uint64_t> counts(kNumberOfRanks + 1, 0);
+    for (size_t i = 0; i < kNumSamples; i++) {
+      auto rank = zipf(engine);
+      ASSERT_GE(rank, 1);
+      ASSERT_LE(rank, kNumberOfRanks);
+      counts[rank]++;
+    }
+    // H(n, theta)
+    double harmonic = 0;
+    for (uint64_t k = 1; k <= kNumberOfRanks; k++) {
+      harmonic += std::pow(k, -theta);
+    }
+    for (uint64_t k = 1; k <= kNumberOfRanks; k++) {
+      expectFrequency(std::pow(k, -theta) / harmonic, counts[k], kNumSamples);
+    }
+  }
+}
+
+TEST(KeyChooserTest, HotProbability) {
+  const uint64_t kNumberOfKeys = 1000;
+  const size_t kNumSamples = 1000000;
+  auto chooser = KeyChooser::make(
+      folly::dynamic::object("type", "hotspot")("hot_fraction", 0.1)(
+          "hot_probability", 0.7),
+      kNumberOfKeys,
+      0);
+  auto counts = countKeys(*chooser, kNumSamples);
+  uint64_t hot = 0;
+  for (uint64_t key = 0; key < 100; key++) {
+    hot += counts[key];
+  }
+  expectFrequency(0.7, hot, kNumSamples);
+  // Uniform within each side
+  expectFrequency(0.7 / 100, counts[0], kNumSamples);
+  expectFrequency(0.3 / 900, counts[kNumberOfKeys - 1], kNumSamples);
+}
+
+TEST(KeyChooserTest, LatestWraps) {
+  const uint64_t kNumberOfKeys = 10;
+  const size_t kNumSamples = 1000000;
+  auto chooser = KeyChooser::make(
+      folly::dynamic::object("type", "latest")("theta", 1.0), kNumberOfKeys, 0);
+  // Before any write the last key is the latest.
+  auto counts = countKeys(*chooser, kNumSamples);
+  EXPECT_EQ(
+      kNumberOfKeys - 1,
+      std::max_element(counts.begin(), counts.end()) - counts.begin());
+
+  // Key 3 is at distance 0, key 9 at distance 4 after wrapping around, and
+  // key 4 at distance 9, the furthest.
+  chooser->recordWrite(3);
+  counts = countKeys(*chooser, kNumSamples);
+  double harmonic = 0;
+  for (uint64_t k = 1; k <= kNumberOfKeys; k++) {
+    harmonic += 1.0 / k;
+  }
+  for (uint64_t distance = 0; distance < kNumberOfKeys; distance++) {
+    uint64_t key = (3 + kNumberOfKeys - distance) % kNumberOfKeys;
+    expectFrequency(1.0 / (distance + 1) / harmonic, counts[key], kNumSamples);
+  }
+  EXPECT_GT(counts[9], counts[4]);
+}
+
+TEST(KeyChooserTest, ResetReplays) {
+  for (const char* type :
+       {"sequential", "uniform", "zipf", "hotspot", "latest"}) {
+    SCOPED_TRACE(type);
+    auto chooser = KeyChooser::make(
+        folly::dynamic::object("type", type), 1000000, 42);
+    auto draw = [&chooser] {
+      std::vector<uint64_t> keys;
+      for (int i = 0; i < 1000; i++) {
+        keys.push_back(chooser->next());
+        if (i % 10 == 0) {
+          chooser->recordWrite(keys.back());
+        }
+      }
+      return keys;
+    };
+    auto first = draw();
+    chooser->reset();
+    EXPECT_EQ(first, draw());
+    chooser->seed(43);
+    if (std::string(type) != "sequential") {
+      EXPECT_NE(first, draw());
+    }
+  }
+}
+
+} // namespace
+
+} // namespace treadmill
+} // namespace windtunnel
+} // namespace facebook
+
+int main(int argc, char* argv[]) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
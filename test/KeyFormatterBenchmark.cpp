@@ -0,0 +1,63 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include <string>
+
+#include <folly/Benchmark.h>
+#include <folly/dynamic.h>
+#include <folly/init/Init.h>
+#include <folly/io/IOBuf.h>
+
+#include "treadmill/KeyFormatter.h"
+
+using facebook::windtunnel::treadmill::KeyFormatter;
+
+namespace {
+
+// Every iteration is one key, so iters/s is keys per second on one core.
+constexpr uint64_t kNumberOfKeys = 1000000;
+
+void formatKeys(size_t iters, const folly::dynamic& config) {
+  std::unique_ptr<KeyFormatter> formatter;
+  BENCHMARK_SUSPEND {
+    formatter = std::make_unique<KeyFormatter>(config, kNumberOfKeys);
+    formatter->setArena(KeyFormatter::makeArena(config, kNumberOfKeys));
+  }
+  for (size_t i = 0; i < iters; i++) {
+    folly::doNotOptimizeAway(formatter->format(i % kNumberOfKeys));
+  }
+}
+
+} // namespace
+
+BENCHMARK(ToStringCopy, iters) {
+  // What the memcached workload used to do: a string, then an IOBuf copy
+  for (size_t i = 0; i < iters; i++) {
+    auto key = std::to_string(i % kNumberOfKeys);
+    folly::doNotOptimizeAway(folly::IOBuf(folly::IOBuf::COPY_BUFFER, key));
+  }
+}
+
+BENCHMARK_RELATIVE(Formatted, iters) {
+  formatKeys(iters, folly::dynamic::object("prefix", "key:")("width", 10));
+}
+
+BENCHMARK_RELATIVE(Precomputed, iters) {
+  formatKeys(
+      iters,
+      folly::dynamic::object("prefix", "key:")("width", 10)(
+          "precompute", true));
+}
+
+int main(int argc, char* argv[]) {
+  folly::init(&argc, &argv);
+  folly::runBenchmarks();
+  return 0;
+}
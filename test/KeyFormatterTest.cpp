@@ -0,0 +1,115 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include "treadmill/KeyFormatter.h"
+
+#include <string>
+#include <vector>
+
+namespace facebook {
+namespace windtunnel {
+namespace treadmill {
+
+namespace {
+
+// Keys are always a single buffer
+std::string toString(const folly::IOBuf& key) {
+  return std::string(reinterpret_cast<const char*>(key.data()), key.length());
+}
+
+std::string formatKey(KeyFormatter& formatter, uint64_t key) {
+  return toString(formatter.format(key));
+}
+
+TEST(KeyFormatterTest, BareNumbers) {
+  KeyFormatter formatter(folly::dynamic::object, 1000);
+  EXPECT_EQ("0", formatKey(formatter, 0));
+  EXPECT_EQ("42", formatKey(formatter, 42));
+  EXPECT_EQ("999", formatKey(formatter, 999));
+  EXPECT_EQ(3, formatter.getMaxSize());
+}
+
+TEST(KeyFormatterTest, PrefixWidthAndPadding) {
+  KeyFormatter formatter(
+      folly::dynamic::object("prefix", "user:")("width", 6)("padding", "x"),
+      1000);
+  EXPECT_EQ("user:xxxxx0", formatKey(formatter, 0));
+  EXPECT_EQ("user:xxxx42", formatKey(formatter, 42));
+  EXPECT_EQ(11, formatter.getMaxSize());
+
+  KeyFormatter zeros(folly::dynamic::object("width", 4), 1000);
+  EXPECT_EQ("0007", formatKey(zeros, 7));
+}
+
+TEST(KeyFormatterTest, WiderThanWidth) {
+  KeyFormatter formatter(
+      folly::dynamic::object("prefix", "k")("width", 2), 1000000);
+  EXPECT_EQ("k05", formatKey(formatter, 5));
+  EXPECT_EQ("k12345", formatKey(formatter, 12345));
+  EXPECT_EQ("k999999", formatKey(formatter, 999999));
+  EXPECT_EQ(7, formatter.getMaxSize());
+}
+
+TEST(KeyFormatterTest, ArenaMatchesSlab) {
+  const uint64_t kNumberOfKeys = 12345;
+  // Fixed length, as width covers every key, then variable length
+  for (int width : {8, 3}) {
+    SCOPED_TRACE(width);
+    auto config = folly::dynamic::object("prefix", "key:")("width", width)(
+        "precompute", true);
+    KeyFormatter slab(config, kNumberOfKeys);
+    KeyFormatter arena(config, kNumberOfKeys);
+    auto keys = KeyFormatter::makeArena(config, kNumberOfKeys);
+    ASSERT_NE(nullptr, keys);
+    EXPECT_EQ(width == 3, !keys->lengths.empty());
+    arena.setArena(keys);
+    ASSERT_TRUE(arena.isPrecomputed());
+    ASSERT_FALSE(slab.isPrecomputed());
+    for (uint64_t key = 0; key < kNumberOfKeys; key++) {
+      ASSERT_EQ(formatKey(slab, key), formatKey(arena, key)) << key;
+    }
+  }
+}
+
+TEST(KeyFormatterTest, NoArenaUnlessPrecompute) {
+  EXPECT_EQ(nullptr, KeyFormatter::makeArena(folly::dynamic::object, 1000));
+  EXPECT_EQ(
+      nullptr,
+      KeyFormatter::makeArena(
+          folly::dynamic::object("precompute", true)("max_arena_mb", 0),
+          1000));
+}
+
+TEST(KeyFormatterTest, SlabKeysOutliveTheSlab) {
+  KeyFormatter formatter(folly::dynamic::object("width", 16), 1000000);
+  // Several 64KB slabs' worth of keys
+  const uint64_t kNumberOfKeys = 20000;
+  std::vector<folly::IOBuf> keys;
+  for (uint64_t key = 0; key < kNumberOfKeys; key++) {
+    keys.push_back(formatter.format(key));
+  }
+  KeyFormatter expected(folly::dynamic::object("width", 16), 1000000);
+  for (uint64_t key = 0; key < kNumberOfKeys; key++) {
+    ASSERT_EQ(formatKey(expected, key), toString(keys[key])) << key;
+  }
+}
+
+} // namespace
+
+} // namespace treadmill
+} // namespace windtunnel
+} // namespace facebook
+
+int main(int argc, char* argv[]) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,105 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <folly/Benchmark.h>
+#include <folly/init/Init.h>
+
+#include "treadmill/RandomEngine.h"
+#include "treadmill/Xoshiro256.h"
+
+using facebook::windtunnel::treadmill::ThreadSafeRandomEngine;
+using facebook::windtunnel::treadmill::Xoshiro256;
+
+namespace {
+
+// Every iteration is one number, so iters/s is numbers per second on one core.
+constexpr size_t kBatch = 256;
+
+} // namespace
+
+BENCHMARK(UniformMt19937, iters) {
+  std::mt19937_64 engine(0);
+  for (size_t i = 0; i < iters; i++) {
+    std::uniform_real_distribution<double> dist(0, 1);
+    folly::doNotOptimizeAway(dist(engine));
+  }
+}
+
+BENCHMARK_RELATIVE(UniformXoshiro256, iters) {
+  Xoshiro256 engine(0);
+  for (size_t i = 0; i < iters; i++) {
+    folly::doNotOptimizeAway(Xoshiro256::toUniform(engine()));
+  }
+}
+
+BENCHMARK_RELATIVE(UniformXoshiro256Batched, iters) {
+  Xoshiro256 engine(0);
+  std::vector<double> batch(kBatch);
+  for (size_t i = 0; i < iters; i += kBatch) {
+    engine.fillUniform(batch.data(), kBatch);
+    folly::doNotOptimizeAway(batch.data());
+  }
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(ExponentialMt19937, iters) {
+  // What Scheduler::randomExponentialInterval used to do
+  std::mt19937 engine;
+  for (size_t i = 0; i < iters; i++) {
+    std::uniform_real_distribution<double> dist(0, 1.0);
+    folly::doNotOptimizeAway(-log(std::max(dist(engine), 1e-9)));
+  }
+}
+
+BENCHMARK_RELATIVE(ExponentialXoshiro256Batched, iters) {
+  Xoshiro256 engine(0);
+  std::vector<double> batch(kBatch);
+  for (size_t i = 0; i < iters; i += kBatch) {
+    engine.fillExponential(batch.data(), kBatch, 1);
+    folly::doNotOptimizeAway(batch.data());
+  }
+}
+
+BENCHMARK_RELATIVE(ExponentialThreadSafe, iters) {
+  for (size_t i = 0; i < iters; i++) {
+    folly::doNotOptimizeAway(ThreadSafeRandomEngine::getExponential(1));
+  }
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(IntegerMt19937, iters) {
+  std::mt19937_64 engine(0);
+  for (size_t i = 0; i < iters; i++) {
+    std::uniform_int_distribution<uint64_t> dist(0, 999999);
+    folly::doNotOptimizeAway(dist(engine));
+  }
+}
+
+BENCHMARK_RELATIVE(IntegerXoshiro256Batched, iters) {
+  Xoshiro256 engine(0);
+  std::vector<uint64_t> batch(kBatch);
+  for (size_t i = 0; i < iters; i += kBatch) {
+    engine.fillInteger(batch.data(), kBatch, 0, 999999);
+    folly::doNotOptimizeAway(batch.data());
+  }
+}
+
+int main(int argc, char* argv[]) {
+  folly::init(&argc, &argv);
+  folly::runBenchmarks();
+  return 0;
+}
@@ -26,6 +26,7 @@ namespace {
 
 using facebook::windtunnel::treadmill::RandomEngine;
 using facebook::windtunnel::treadmill::ThreadSafeRandomEngine;
+using facebook::windtunnel::treadmill::Xoshiro256;
 
 void checkCorrelation(std::function<double(double, double)> prng) {
   // test 10 threads
@@ -86,6 +87,87 @@ TEST(StatisticTest, CrossThreadCorrelation) {
   checkCorrelation(ThreadSafeRandomEngine::getDouble);
 }
 
+TEST(StatisticTest, CrossThreadExponentialCorrelation) {
+  // Exponential with mean 1 is -log of a uniform; map it back onto [min, max]
+  checkCorrelation([](double min, double max) {
+    return min + std::exp(-ThreadSafeRandomEngine::getExponential(1)) *
+        (max - min);
+  });
+}
+
+TEST(StatisticTest, StreamsRepeat) {
+  // Stream i of the master seed, drawn on a new thread
+  auto draw = [](uint64_t stream_id) {
+    std::vector<uint64_t> numbers;
+    std::thread thread([&numbers, stream_id] {
+      ThreadSafeRandomEngine::setStream(stream_id);
+      for (int i = 0; i < 100; i++) {
+        numbers.push_back(ThreadSafeRandomEngine::getInteger(0, 1000000));
+      }
+    });
+    thread.join();
+    return numbers;
+  };
+  EXPECT_EQ(draw(3), draw(3));
+  EXPECT_NE(draw(3), draw(4));
+  EXPECT_EQ(
+      RandomEngine::deriveSeed(RandomEngine::getSeed(), 1),
+      RandomEngine::deriveSeed(RandomEngine::getSeed(), 1));
+  EXPECT_NE(
+      RandomEngine::deriveSeed(RandomEngine::getSeed(), 1),
+      RandomEngine::deriveSeed(RandomEngine::getSeed(), 2));
+}
+
+TEST(Xoshiro256Test, FillMatchesScalar) {
+  const size_t kNumSamples = 1000;
+  Xoshiro256 scalar(42);
+  Xoshiro256 batched(42);
+  std::vector<double> uniforms(kNumSamples);
+  std::vector<double> exponentials(kNumSamples);
+  std::vector<uint64_t> integers(kNumSamples);
+  batched.fillUniform(uniforms.data(), kNumSamples);
+  batched.fillExponential(exponentials.data(), kNumSamples, 2);
+  batched.fillInteger(integers.data(), kNumSamples, 10, 20);
+  for (size_t i = 0; i < kNumSamples; i++) {
+    ASSERT_EQ(Xoshiro256::toUniform(scalar()), uniforms[i]);
+  }
+  for (size_t i = 0; i < kNumSamples; i++) {
+    ASSERT_EQ(-std::log(Xoshiro256::toUniform(scalar())) * 2, exponentials[i]);
+  }
+  for (size_t i = 0; i < kNumSamples; i++) {
+    ASSERT_EQ(Xoshiro256::toInteger(scalar(), 10, 20), integers[i]);
+    ASSERT_GE(integers[i], 10);
+    ASSERT_LE(integers[i], 20);
+  }
+}
+
+TEST(Xoshiro256Test, ExponentialMoments) {
+  const size_t kNumSamples = 1000000;
+  const double kMean = 5;
+  Xoshiro256 engine(0);
+  std::vector<double> samples(kNumSamples);
+  engine.fillExponential(samples.data(), kNumSamples, kMean);
+  double sum = std::accumulate(samples.begin(), samples.end(), 0.0);
+  double mean = sum / kNumSamples;
+  double variance = 0;
+  for (auto x : samples) {
+    ASSERT_GT(x, 0);
+    variance += (x - mean) * (x - mean);
+  }
+  variance /= kNumSamples;
+  EXPECT_NEAR(kMean, mean, kMean * 0.01);
+  EXPECT_NEAR(kMean * kMean, variance, kMean * kMean * 0.02);
+}
+
+TEST(Xoshiro256Test, JumpedStreamsDiffer) {
+  Xoshiro256 first(7);
+  Xoshiro256 second = first;
+  second.jump();
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_NE(first(), second());
+  }
+}
+
 } // namespace
 
 } // namespace treadmill
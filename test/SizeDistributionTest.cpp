@@ -0,0 +1,103 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include "treadmill/SizeDistribution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <vector>
+
+namespace facebook {
+namespace windtunnel {
+namespace treadmill {
+
+namespace {
+
+// Sorted sizes drawn from the distribution config describes
+std::vector<size_t> drawSizes(const folly::dynamic& config, size_t n) {
+  auto distribution = SizeDistribution::make(config, 0);
+  std::vector<size_t> sizes(n);
+  for (auto& size : sizes) {
+    size = distribution->next();
+  }
+  std::sort(sizes.begin(), sizes.end());
+  return sizes;
+}
+
+TEST(SizeDistributionTest, Uniform) {
+  auto config = folly::dynamic::object("type", "uniform")("min", 10)("max", 19);
+  auto sizes = drawSizes(config, 100000);
+  EXPECT_EQ(10, sizes.front());
+  EXPECT_EQ(19, sizes.back());
+  std::map<size_t, size_t> counts;
+  for (auto size : sizes) {
+    counts[size]++;
+  }
+  for (const auto& count : counts) {
+    EXPECT_NEAR(0.1, double(count.second) / sizes.size(), 0.005);
+  }
+  EXPECT_EQ(19, SizeDistribution::make(config, 0)->getMaxSize());
+}
+
+TEST(SizeDistributionTest, Empirical) {
+  auto config = folly::dynamic::object("type", "empirical")(
+      "sizes", folly::dynamic::array(100, 1000, 10))(
+      "weights", folly::dynamic::array(1, 3, 0));
+  auto sizes = drawSizes(config, 100000);
+  EXPECT_EQ(100, sizes.front());
+  EXPECT_EQ(1000, sizes.back());
+  double large = std::count(sizes.begin(), sizes.end(), 1000);
+  EXPECT_NEAR(0.75, large / sizes.size(), 0.01);
+  EXPECT_EQ(1000, SizeDistribution::make(config, 0)->getMaxSize());
+}
+
+TEST(SizeDistributionTest, GevMedian) {
+  // The defaults: the ETC key size fit
+  const double location = 30.7984, scale = 8.20449, shape = 0.078688;
+  auto sizes = drawSizes(folly::dynamic::object("type", "gev"), 100001);
+  double median =
+      location + scale * std::expm1(-shape * std::log(std::log(2))) / shape;
+  EXPECT_NEAR(median, sizes[sizes.size() / 2], 1);
+  EXPECT_GE(sizes.front(), 1);
+}
+
+TEST(SizeDistributionTest, ParetoMedian) {
+  // The defaults: the ETC value size fit
+  const double scale = 214.476, shape = 0.348238;
+  auto sizes = drawSizes(folly::dynamic::object("type", "pareto"), 100001);
+  double median = scale * std::expm1(shape * std::log(2)) / shape;
+  EXPECT_NEAR(median, sizes[sizes.size() / 2], median * 0.02);
+  EXPECT_GE(sizes.front(), 1);
+}
+
+TEST(SizeDistributionTest, Clamped) {
+  for (const char* type : {"gev", "pareto"}) {
+    auto config = folly::dynamic::object("type", type)("min", 30)("max", 40);
+    auto sizes = drawSizes(config, 100000);
+    // The bounds are well inside both distributions, so both get hit.
+    EXPECT_EQ(30, sizes.front()) << type;
+    EXPECT_EQ(40, sizes.back()) << type;
+    EXPECT_EQ(40, SizeDistribution::make(config, 0)->getMaxSize()) << type;
+  }
+}
+
+} // namespace
+
+} // namespace treadmill
+} // namespace windtunnel
+} // namespace facebook
+
+int main(int argc, char* argv[]) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
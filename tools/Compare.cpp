@@ -0,0 +1,404 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+/**
+ * Compares the latency distribution, throughput and error rate of two
+ * treadmill runs written with --output_file, or of two phases of one run:
+ *
+ *   treadmill_compare baseline.json candidate.json
+ *   treadmill_compare --baseline_phase=A --candidate_phase=B results.json
+ *
+ * Exits with status 1 if the candidate regressed past the thresholds.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <folly/Conv.h>
+#include <folly/Format.h>
+#include <folly/String.h>
+#include <folly/dynamic.h>
+#include <folly/init/Init.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "treadmill/Histogram.h"
+#include "treadmill/Util.h"
+
+DEFINE_string(
+    baseline_phase,
+    "",
+    "Phase of the baseline file to compare. All phases merged if empty.");
+
+DEFINE_string(
+    candidate_phase,
+    "",
+    "Phase of the candidate file to compare. All phases merged if empty.");
+
+DEFINE_string(
+    histogram,
+    "request_latency",
+    "Name of the latency histogram to compare, e.g. request_latency.get.");
+
+DEFINE_string(
+    quantiles,
+    "50,90,99,99.9",
+    "Comma-separated percentiles to compare.");
+
+DEFINE_int32(bootstrap_iterations, 2000, "Number of bootstrap resamples.");
+
+DEFINE_double(
+    confidence,
+    0.95,
+    "Confidence level of the intervals of the quantile deltas.");
+
+DEFINE_double(
+    significance,
+    0.01,
+    "A latency difference only counts as a regression if the KS test p-value "
+    "is below this.");
+
+DEFINE_double(
+    max_latency_regression_pct,
+    5.0,
+    "Fail if a quantile is worse by more than this percentage with the "
+    "requested confidence.");
+
+DEFINE_double(
+    max_throughput_regression_pct,
+    5.0,
+    "Fail if the average throughput dropped by more than this percentage.");
+
+DEFINE_double(
+    max_error_rate_increase_pct,
+    0.1,
+    "Fail if the error rate grew by more than this many percentage points.");
+
+DEFINE_int64(bootstrap_seed, 1, "Seed of the bootstrap random generators.");
+
+using namespace facebook::windtunnel::treadmill;
+
+namespace {
+
+/**
+ * A latency distribution as the value and count of every non-empty bucket.
+ */
+struct Distribution {
+  std::vector<double> values;
+  std::vector<uint64_t> counts;
+  uint64_t total{0};
+};
+
+/**
+ * The results of one run or phase.
+ */
+struct Sample {
+  std::string name;
+  folly::dynamic stats;
+};
+
+Sample loadSample(const std::string& filename, const std::string& phase) {
+  auto results = readDynamicFromFile(filename);
+  if (phase.empty()) {
+    return {filename, results};
+  }
+  auto phase_stats = results["phases"].get_ptr(phase);
+  if (phase_stats == nullptr) {
+    LOG(FATAL) << filename << " has no phase " << phase;
+  }
+  return {folly::sformat("{}:{}", filename, phase), *phase_stats};
+}
+
+/**
+ * Bring both histograms to a common precision, and list their buckets
+ * aligned on the same bucket boundaries.
+ */
+std::pair<Distribution, Distribution> alignDistributions(
+    const folly::dynamic& a,
+    const folly::dynamic& b) {
+  auto histogram_a = Histogram::fromDynamic(a);
+  auto histogram_b = Histogram::fromDynamic(b);
+  Histogram common_a(std::min(
+      histogram_a.getSignificantBits(), histogram_b.getSignificantBits()));
+  Histogram common_b(common_a.getSignificantBits());
+  // Buckets of a finer histogram nest in those of a coarser one, so adding
+  // lower bounds moves every count to the right coarser bucket.
+  histogram_a.forEachBucket([&](uint64_t lower, uint64_t, uint64_t count) {
+    common_a.addInteger(lower, count);
+  });
+  histogram_b.forEachBucket([&](uint64_t lower, uint64_t, uint64_t count) {
+    common_b.addInteger(lower, count);
+  });
+
+  std::map<uint64_t, std::pair<uint64_t, uint64_t>> buckets;
+  std::map<uint64_t, double> values;
+  common_a.forEachBucket(
+      [&](uint64_t lower, uint64_t upper, uint64_t count) {
+        buckets[lower].first = count;
+        values[lower] = (lower + upper) / 2.0;
+      });
+  common_b.forEachBucket(
+      [&](uint64_t lower, uint64_t upper, uint64_t count) {
+        buckets[lower].second = count;
+        values[lower] = (lower + upper) / 2.0;
+      });
+
+  Distribution result_a, result_b;
+  for (const auto& bucket : buckets) {
+    result_a.values.push_back(values[bucket.first]);
+    result_a.counts.push_back(bucket.second.first);
+    result_a.total += bucket.second.first;
+    result_b.values.push_back(values[bucket.first]);
+    result_b.counts.push_back(bucket.second.second);
+    result_b.total += bucket.second.second;
+  }
+  return {std::move(result_a), std::move(result_b)};
+}
+
+// Same rank definition as Histogram::getQuantiles().
+std::vector<double> quantilesOf(
+    const std::vector<double>& values,
+    const std::vector<uint64_t>& counts,
+    uint64_t total,
+    const std::vector<double>& quantiles) {
+  std::vector<double> result;
+  for (auto q : quantiles) {
+    uint64_t rank = std::max<uint64_t>(1, std::ceil(q * total));
+    uint64_t seen = 0;
+    size_t i = 0;
+    while (i + 1 < counts.size() && seen + counts[i] < rank) {
+      seen += counts[i++];
+    }
+    result.push_back(values[i]);
+  }
+  return result;
+}
+
+/**
+ * Draw the bucket counts of a resample of the distribution, i.e. a
+ * multinomial sample of the same size, as a chain of binomial draws. This
+ * costs one draw per bucket however many samples the distribution holds.
+ */
+void resample(
+    const Distribution& distribution,
+    std::mt19937_64& rng,
+    std::vector<uint64_t>& counts) {
+  uint64_t remaining = distribution.total;
+  uint64_t remaining_weight = distribution.total;
+  for (size_t i = 0; i < distribution.counts.size(); ++i) {
+    if (remaining == 0 || distribution.counts[i] == remaining_weight) {
+      counts[i] = remaining;
+    } else {
+      std::binomial_distribution<uint64_t> binomial(
+          remaining, double(distribution.counts[i]) / remaining_weight);
+      counts[i] = binomial(rng);
+    }
+    remaining -= counts[i];
+    remaining_weight -= distribution.counts[i];
+  }
+}
+
+/**
+ * Bootstrap the relative difference (b - a) / a of every quantile. Returns
+ * the [low, high] confidence interval of each.
+ */
+std::vector<std::pair<double, double>> bootstrapDeltas(
+    const Distribution& a,
+    const Distribution& b,
+    const std::vector<double>& quantiles) {
+  size_t number_of_threads =
+      std::max<size_t>(1, std::thread::hardware_concurrency());
+  size_t iterations = FLAGS_bootstrap_iterations;
+  // deltas[q][iteration]
+  std::vector<std::vector<double>> deltas(
+      quantiles.size(), std::vector<double>(iterations));
+
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < number_of_threads; ++t) {
+    threads.emplace_back([&, t] {
+      std::mt19937_64 rng(FLAGS_bootstrap_seed + t);
+      std::vector<uint64_t> counts_a(a.counts.size());
+      std::vector<uint64_t> counts_b(b.counts.size());
+      for (size_t i = t; i < iterations; i += number_of_threads) {
+        resample(a, rng, counts_a);
+        resample(b, rng, counts_b);
+        auto qa = quantilesOf(a.values, counts_a, a.total, quantiles);
+        auto qb = quantilesOf(b.values, counts_b, b.total, quantiles);
+        for (size_t q = 0; q < quantiles.size(); ++q) {
+          deltas[q][i] = qa[q] > 0 ? (qb[q] - qa[q]) / qa[q] : 0.0;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  std::vector<std::pair<double, double>> intervals;
+  double tail = (1.0 - FLAGS_confidence) / 2;
+  for (auto& samples : deltas) {
+    std::sort(samples.begin(), samples.end());
+    auto at = [&](double p) {
+      return samples[std::min<size_t>(p * iterations, iterations - 1)];
+    };
+    intervals.emplace_back(at(tail), at(1.0 - tail));
+  }
+  return intervals;
+}
+
+/**
+ * Two-sample Kolmogorov-Smirnov test over the bucketed distributions.
+ * Returns the statistic D and its asymptotic p-value.
+ */
+std::pair<double, double> ksTest(const Distribution& a, const Distribution& b) {
+  double d = 0;
+  uint64_t seen_a = 0, seen_b = 0;
+  for (size_t i = 0; i < a.counts.size(); ++i) {
+    seen_a += a.counts[i];
+    seen_b += b.counts[i];
+    d = std::max(
+        d, std::abs(double(seen_a) / a.total - double(seen_b) / b.total));
+  }
+
+  double n = double(a.total) * b.total / (a.total + b.total);
+  double lambda = (std::sqrt(n) + 0.12 + 0.11 / std::sqrt(n)) * d;
+  double p = 0;
+  for (int k = 1; k <= 100; ++k) {
+    double term = 2 * std::exp(-2.0 * k * k * lambda * lambda);
+    p += (k % 2 == 1) ? term : -term;
+    if (term < 1e-12) {
+      break;
+    }
+  }
+  return {d, std::min(std::max(p, 0.0), 1.0)};
+}
+
+double throughputOf(const Sample& sample) {
+  auto throughput = sample.stats["histograms"].get_ptr("throughput");
+  return throughput ? (*throughput)["avg"].asDouble() : 0.0;
+}
+
+// Errors over requests, summed over the per-operation counters.
+double errorRateOf(const Sample& sample) {
+  int64_t requests = 0, errors = 0;
+  for (const auto& counter : sample.stats["counters"].items()) {
+    if (counter.first.find("requests.") == 0) {
+      requests += counter.second["count"].asInt();
+    } else if (counter.first.find("errors.") == 0) {
+      errors += counter.second["count"].asInt();
+    }
+  }
+  return requests == 0 ? 0.0 : double(errors) / requests;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  gflags::SetUsageMessage(
+      "treadmill_compare [flags] baseline.json [candidate.json]");
+  folly::init(&argc, &argv);
+  if (argc != 2 && argc != 3) {
+    LOG(FATAL) << "Expected one or two result files";
+  }
+  if (argc == 2 && FLAGS_baseline_phase == FLAGS_candidate_phase) {
+    LOG(FATAL) << "Comparing phases of one file needs --baseline_phase and "
+               << "--candidate_phase";
+  }
+  CHECK_GT(FLAGS_bootstrap_iterations, 0);
+
+  auto baseline = loadSample(argv[1], FLAGS_baseline_phase);
+  auto candidate = loadSample(argv[argc - 1], FLAGS_candidate_phase);
+  LOG(INFO) << "Baseline: " << baseline.name;
+  LOG(INFO) << "Candidate: " << candidate.name;
+
+  std::vector<double> quantiles;
+  std::vector<folly::StringPiece> percentiles;
+  folly::split(',', FLAGS_quantiles, percentiles, true);
+  for (auto percentile : percentiles) {
+    quantiles.push_back(folly::to<double>(percentile) / 100);
+  }
+
+  auto histogram_a = baseline.stats["histograms"].get_ptr(FLAGS_histogram);
+  auto histogram_b = candidate.stats["histograms"].get_ptr(FLAGS_histogram);
+  if (histogram_a == nullptr || histogram_b == nullptr) {
+    LOG(FATAL) << "Histogram " << FLAGS_histogram << " missing";
+  }
+  auto distributions = alignDistributions(*histogram_a, *histogram_b);
+  const auto& a = distributions.first;
+  const auto& b = distributions.second;
+  if (a.total == 0 || b.total == 0) {
+    LOG(FATAL) << "Histogram " << FLAGS_histogram << " is empty";
+  }
+
+  bool regressed = false;
+  auto ks = ksTest(a, b);
+  bool significant = ks.second < FLAGS_significance;
+  LOG(INFO) << folly::sformat(
+      "{}: {} vs {} samples, KS D = {:.4f}, p = {:.3g}{}",
+      FLAGS_histogram,
+      a.total,
+      b.total,
+      ks.first,
+      ks.second,
+      significant ? " (significant)" : "");
+
+  auto point_a = quantilesOf(a.values, a.counts, a.total, quantiles);
+  auto point_b = quantilesOf(b.values, b.counts, b.total, quantiles);
+  auto intervals = bootstrapDeltas(a, b, quantiles);
+  for (size_t q = 0; q < quantiles.size(); ++q) {
+    double delta =
+        point_a[q] > 0 ? (point_b[q] - point_a[q]) / point_a[q] : 0.0;
+    bool worse = significant &&
+        intervals[q].first * 100 > FLAGS_max_latency_regression_pct;
+    regressed |= worse;
+    LOG(INFO) << folly::sformat(
+        "  p{:g}: {:.1f} -> {:.1f} ({:+.2f}%, {:g}% CI [{:+.2f}%, {:+.2f}%]){}",
+        quantiles[q] * 100,
+        point_a[q],
+        point_b[q],
+        delta * 100,
+        FLAGS_confidence * 100,
+        intervals[q].first * 100,
+        intervals[q].second * 100,
+        worse ? " REGRESSION" : "");
+  }
+
+  double throughput_a = throughputOf(baseline);
+  double throughput_b = throughputOf(candidate);
+  if (throughput_a > 0) {
+    double delta = (throughput_b - throughput_a) / throughput_a;
+    bool worse = -delta * 100 > FLAGS_max_throughput_regression_pct;
+    regressed |= worse;
+    LOG(INFO) << folly::sformat(
+        "throughput: {:.1f} -> {:.1f} ({:+.2f}%){}",
+        throughput_a,
+        throughput_b,
+        delta * 100,
+        worse ? " REGRESSION" : "");
+  }
+
+  double error_rate_a = errorRateOf(baseline);
+  double error_rate_b = errorRateOf(candidate);
+  bool worse =
+      (error_rate_b - error_rate_a) * 100 > FLAGS_max_error_rate_increase_pct;
+  regressed |= worse;
+  LOG(INFO) << folly::sformat(
+      "error rate: {:.4f}% -> {:.4f}%{}",
+      error_rate_a * 100,
+      error_rate_b * 100,
+      worse ? " REGRESSION" : "");
+
+  return regressed ? 1 : 0;
+}
@@ -0,0 +1,147 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+/**
+ * Converts a text request trace into the binary format replayed with
+ * --replay_trace.
+ *
+ *   treadmill_replay_converter --output=trace.replay requests.csv
+ *
+ * Every line is one request: timestamp, operation, key and, optionally, value
+ * size, separated by --delimiter and sorted by timestamp. The operation is a
+ * name from --operations or its index in that list. A first line whose
+ * timestamp isn't a number is taken as a header and skipped.
+ */
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <folly/Conv.h>
+#include <folly/String.h>
+#include <folly/init/Init.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "treadmill/ReplayTrace.h"
+
+DEFINE_string(output, "", "Binary replay trace to write.");
+DEFINE_string(
+    delimiter,
+    ",",
+    "Field separator; with a space, runs of spaces count as one.");
+DEFINE_string(
+    timestamp_unit,
+    "s",
+    "Unit of the timestamps in the input: s, ms, us or ns.");
+DEFINE_string(
+    operations,
+    "get,set,delete",
+    "Operation names, in the order of the workload's operation labels.");
+
+using namespace facebook::windtunnel::treadmill;
+
+namespace {
+
+double nsPerUnit(const std::string& unit) {
+  if (unit == "s") {
+    return 1e9;
+  } else if (unit == "ms") {
+    return 1e6;
+  } else if (unit == "us") {
+    return 1e3;
+  } else if (unit == "ns") {
+    return 1;
+  }
+  LOG(FATAL) << "Unknown timestamp unit: " << unit;
+  return 0;
+}
+
+uint8_t parseOperation(
+    folly::StringPiece field,
+    const std::vector<std::string>& operations) {
+  for (size_t i = 0; i < operations.size(); ++i) {
+    if (field == operations[i]) {
+      return i;
+    }
+  }
+  auto index = folly::tryTo<uint8_t>(field);
+  if (!index.hasValue() || index.value() >= operations.size()) {
+    LOG(FATAL) << "Unknown operation: " << field;
+  }
+  return index.value();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  gflags::SetUsageMessage(
+      "treadmill_replay_converter --output=trace.replay [input]");
+  folly::init(&argc, &argv);
+  CHECK(!FLAGS_output.empty()) << "--output is required";
+
+  FILE* input = stdin;
+  if (argc > 1 && std::string(argv[1]) != "-") {
+    input = fopen(argv[1], "r");
+    PCHECK(input != nullptr) << "Failed to open " << argv[1];
+  }
+
+  std::vector<std::string> operations;
+  folly::split(",", FLAGS_operations, operations);
+  double ns_per_unit = nsPerUnit(FLAGS_timestamp_unit);
+  bool ignore_empty = FLAGS_delimiter == " ";
+
+  ReplayTraceWriter writer(FLAGS_output);
+  char* line = nullptr;
+  size_t capacity = 0;
+  ssize_t length;
+  uint64_t line_number = 0;
+  bool have_start = false;
+  double start = 0;
+  std::vector<folly::StringPiece> fields;
+  while ((length = getline(&line, &capacity, input)) >= 0) {
+    ++line_number;
+    auto text = folly::rtrimWhitespace(folly::StringPiece(line, length));
+    if (text.empty()) {
+      continue;
+    }
+    fields.clear();
+    folly::split(FLAGS_delimiter, text, fields, ignore_empty);
+    auto timestamp = folly::tryTo<double>(folly::trimWhitespace(fields[0]));
+    if (!timestamp.hasValue() && line_number == 1) {
+      continue;
+    }
+    CHECK(timestamp.hasValue() && fields.size() >= 3)
+        << "Line " << line_number << " isn't timestamp, operation, key"
+        << "[, value size]: " << text;
+    if (!have_start) {
+      start = timestamp.value();
+      have_start = true;
+    }
+    writer.add(
+        (timestamp.value() - start) * ns_per_unit,
+        parseOperation(folly::trimWhitespace(fields[1]), operations),
+        folly::trimWhitespace(fields[2]),
+        fields.size() > 3
+            ? folly::to<uint32_t>(folly::trimWhitespace(fields[3]))
+            : 0);
+  }
+  free(line);
+  if (input != stdin) {
+    fclose(input);
+  }
+  writer.finish();
+
+  ReplayTrace trace(FLAGS_output);
+  LOG(INFO) << "Wrote " << trace.size() << " requests over "
+            << (trace.size() ? trace[trace.size() - 1].timestamp_ns / 1e9 : 0)
+            << " s to " << FLAGS_output;
+  return 0;
+}
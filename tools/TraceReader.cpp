@@ -0,0 +1,137 @@
+/*
+ *  Copyright (c) 2014, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+/**
+ * Converts request traces written with --trace_dir to CSV and recomputes
+ * latency quantiles from them.
+ *
+ *   treadmill_trace_reader --csv_file=requests.csv trace.0.bin trace.1.bin
+ */
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <folly/Format.h>
+#include <folly/init/Init.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "treadmill/Histogram.h"
+#include "treadmill/RequestTrace.h"
+
+DEFINE_string(
+    csv_file,
+    "",
+    "If set, write every record of the traces to this file as CSV.");
+
+using namespace facebook::windtunnel::treadmill;
+
+namespace {
+
+const std::vector<double> kQuantiles = {0.5, 0.9, 0.95, 0.99, 0.999, 1.0};
+
+const char* statusName(TraceStatus status) {
+  switch (status) {
+    case TraceStatus::OK:
+      return "ok";
+    case TraceStatus::ERROR:
+      return "error";
+    case TraceStatus::DROPPED:
+      return "dropped";
+  }
+  return "unknown";
+}
+
+void printHistogram(const std::string& name, const Histogram& histogram) {
+  LOG(INFO) << name << " (us): count " << histogram.getCount() << ", avg "
+            << histogram.getMean();
+  auto values = histogram.getQuantiles(kQuantiles);
+  for (size_t i = 0; i < kQuantiles.size(); ++i) {
+    LOG(INFO) << folly::sformat("  p{}: {}", kQuantiles[i] * 100, values[i]);
+  }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  gflags::SetUsageMessage("treadmill_trace_reader [flags] trace.bin...");
+  folly::init(&argc, &argv);
+  if (argc < 2) {
+    LOG(FATAL) << "No trace files given";
+  }
+
+  FILE* csv = nullptr;
+  if (!FLAGS_csv_file.empty()) {
+    csv = fopen(FLAGS_csv_file.c_str(), "w");
+    PCHECK(csv != nullptr) << "Failed to open " << FLAGS_csv_file;
+    fprintf(
+        csv,
+        "worker,intended_time_ns,send_time_ns,receive_time_ns,connection,"
+        "operation,status,payload_size\n");
+  }
+
+  // Latency as the service saw it, and as a user would have seen it had the
+  // request been sent on schedule (i.e. including queueing in the client).
+  Histogram service_latency;
+  Histogram scheduled_latency;
+  uint64_t errors = 0;
+  uint64_t dropped = 0;
+  uint64_t overwritten = 0;
+  for (int i = 1; i < argc; ++i) {
+    RequestTraceReader reader(argv[i]);
+    const auto& header = reader.header();
+    overwritten += header.records_written - reader.size();
+    LOG(INFO) << argv[i] << ": worker " << header.worker << ", "
+              << reader.size() << " records, 1 in " << header.sample_rate
+              << " sampled";
+
+    for (uint64_t j = 0; j < reader.size(); ++j) {
+      const auto& record = reader[j];
+      if (csv) {
+        fprintf(
+            csv,
+            "%u,%ld,%ld,%ld,%u,%u,%s,%u\n",
+            unsigned(record.worker),
+            long(record.intended_time_ns),
+            long(record.send_time_ns),
+            long(record.receive_time_ns),
+            record.connection,
+            unsigned(record.operation),
+            statusName(record.status),
+            record.payload_size);
+      }
+      if (record.status == TraceStatus::DROPPED) {
+        ++dropped;
+        continue;
+      }
+      if (record.status == TraceStatus::ERROR) {
+        ++errors;
+      }
+      service_latency.addValue(
+          (record.receive_time_ns - record.send_time_ns) / 1000.0);
+      if (record.intended_time_ns != 0) {
+        scheduled_latency.addValue(
+            (record.receive_time_ns - record.intended_time_ns) / 1000.0);
+      }
+    }
+  }
+
+  if (csv) {
+    PCHECK(fclose(csv) == 0) << "Failed to write " << FLAGS_csv_file;
+  }
+
+  LOG(INFO) << "Errors: " << errors << ", dropped: " << dropped
+            << ", overwritten: " << overwritten;
+  printHistogram("Latency", service_latency);
+  printHistogram("Latency from intended send time", scheduled_latency);
+  return 0;
+}